@@ -0,0 +1,294 @@
+// Copyright 2018 Alexey Korepanov & Terry Lyons
+
+// Benchmarks of p_var, p_var_value and p_var_real::pvar for regression tracking.
+//
+// Usage:
+//   bench.x [--min-size N] [--max-size N] [--reps R] [--warmup W] [--p P] [--csv | --json]
+// Sizes go through the powers of 10 from min-size to max-size (default 10^3..10^6, up to 10^8).
+// Each case is run W times for warm-up and then R times, and reports the median and
+// 95th percentile wall clock time, throughput in points per second of the median,
+// and the peak resident memory during the case (on Linux, otherwise of the whole process).
+// Paths have fixed seeds, so that runs are comparable.
+// make bench-blocked builds bench-blocked.x with -DP_VAR_BLOCKED_INDEX, whose p_var engines
+// use blocked_dyadic_index and are named p_var_blocked and p_var_value_blocked, so that
+// the output of both binaries compares the flat and the blocked index layouts.
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <functional>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+#include "p_var.h"
+#include "p_var_real.h"
+
+using p_var_ns::p_var;
+
+// suffix of the names of the engines which use the spatial index
+#ifdef P_VAR_BLOCKED_INDEX
+const std::string index_layout = "_blocked";
+#else
+const std::string index_layout = "";
+#endif
+
+// constructor for random Brownian paths
+std::vector<double> make_brownian_path(double sd, size_t steps, unsigned seed) {
+	std::default_random_engine generator(seed);
+	std::normal_distribution<double> gauss_dist(0.0, sd);
+	std::vector<double> increments(steps), path(1, 0.);
+	auto gauss_rv = [&]() { return gauss_dist(generator); }; // bind the generator
+	std::generate(begin(increments), end(increments), gauss_rv);
+	std::partial_sum(begin(increments), end(increments), back_inserter(path));
+	return path;
+}
+
+// path gelerated by an intermittent dynamical system, like Levy
+// alpha should be in (1/2, 1)
+std::vector<double> make_intermittent_path(size_t steps, double alpha, unsigned seed) {
+	auto LSV = [alpha](double x) {
+		if (x <= 0 || x >= 0.5) {
+			return 0.0;
+		}
+		return x * (1. + std::pow(2*x, alpha));
+	};
+	auto SLSV = [&LSV](double x) {
+		return (x <= 0.5) ? LSV(x) : (1. - LSV(1. - x));
+	};
+
+	std::default_random_engine generator(seed);
+	std::uniform_real_distribution<double> unif(0.0, 1.0);
+	double x = unif(generator);
+
+	std::vector<double> path(steps + 1);
+	path[0] = 0.;
+	double norm = std::pow(steps + 1, -alpha);
+	for (size_t k=1; k < path.size(); k++) {
+		path[k] = path[k-1] + (SLSV(x) - 0.5) * norm;
+		x = SLSV(x);
+	}
+	return path;
+}
+
+// periodic path 0,1,1,4,0,1,1,4,...
+std::vector<double> make_periodic_path(size_t steps) {
+	const double period[] = {0, 1, 1, 4};
+	std::vector<double> path(steps + 1);
+	for (size_t j = 0; j < path.size(); j++) {
+		path[j] = period[j % 4];
+	}
+	return path;
+}
+
+const size_t d = 3;
+typedef std::array<double, d> vecRd;
+
+std::vector<vecRd> make_brownian_path_Rd(size_t steps, unsigned seed) {
+	double sd = 1 / std::sqrt(double(steps));
+	std::vector<vecRd> path(steps + 1);
+	for (size_t i = 0; i < d; i++) {
+		std::vector<double> x = make_brownian_path(sd, steps, seed + unsigned(i));
+		for (size_t j = 0; j <= steps; j++) {
+			path[j][i] = x[j];
+		}
+	}
+	return path;
+}
+
+// peak resident memory in bytes since the last reset_peak_memory(), 0 if unknown
+void reset_peak_memory() {
+#ifdef __linux__
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5";
+#endif
+}
+
+size_t peak_memory() {
+#ifdef __linux__
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 6, "VmHWM:") == 0) {
+			return size_t(std::stoull(line.substr(6))) * 1024;
+		}
+	}
+#endif
+#ifdef __unix__
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		return size_t(usage.ru_maxrss) * 1024;
+	}
+#endif
+	return 0;
+}
+
+struct bench_result {
+	std::string path;
+	std::string engine;
+	size_t size;
+	double value;
+	double median;
+	double p95;
+	double throughput;
+	size_t memory;
+};
+
+// run f warmup + reps times, f returns the p-variation
+bench_result bench(const std::string & path, const std::string & engine, size_t size,
+		unsigned warmup, unsigned reps, const std::function<double()> & f)
+{
+	bench_result r;
+	r.path = path;
+	r.engine = engine;
+	r.size = size;
+	reset_peak_memory();
+	for (unsigned k = 0; k < warmup; k++) {
+		r.value = f();
+	}
+	std::vector<double> secs;
+	for (unsigned k = 0; k < reps; k++) {
+		auto clock_begin = std::chrono::steady_clock::now();
+		r.value = f();
+		auto clock_end = std::chrono::steady_clock::now();
+		secs.push_back(std::chrono::duration<double>(clock_end - clock_begin).count());
+	}
+	std::sort(secs.begin(), secs.end());
+	r.median = secs[secs.size() / 2];
+	r.p95 = secs[std::min(secs.size() - 1, size_t(std::ceil(0.95 * secs.size())) - 1)];
+	r.throughput = double(size) / r.median;
+	r.memory = peak_memory();
+	return r;
+}
+
+int main(int argc, char ** argv) {
+	using std::cout;
+
+	size_t min_size = 1000;
+	size_t max_size = 1000000;
+	unsigned reps = 5;
+	unsigned warmup = 1;
+	double p = 2.5;
+	std::string format = "table";
+	for (int k = 1; k < argc; k++) {
+		std::string arg = argv[k];
+		bool has_value = k + 1 < argc;
+		if (arg == "--min-size" && has_value) {
+			min_size = std::stoull(argv[++k]);
+		}
+		else if (arg == "--max-size" && has_value) {
+			max_size = std::stoull(argv[++k]);
+		}
+		else if (arg == "--reps" && has_value) {
+			reps = std::max(1, std::stoi(argv[++k]));
+		}
+		else if (arg == "--warmup" && has_value) {
+			warmup = std::stoi(argv[++k]);
+		}
+		else if (arg == "--p" && has_value) {
+			p = std::stod(argv[++k]);
+		}
+		else if (arg == "--csv") {
+			format = "csv";
+		}
+		else if (arg == "--json") {
+			format = "json";
+		}
+		else {
+			std::cerr << "usage: " << argv[0]
+				<< " [--min-size N] [--max-size N] [--reps R] [--warmup W] [--p P] [--csv | --json]\n";
+			return 1;
+		}
+	}
+
+	std::vector<bench_result> results;
+	auto report = [&](const bench_result & r) {
+		results.push_back(r);
+		if (format == "table") {
+			cout	<< std::setw(15) << r.path
+				<< std::setw(20) << r.engine
+				<< std::setw(15) << r.size
+				<< std::setw(15) << r.value
+				<< std::setw(15) << r.median
+				<< std::setw(15) << r.p95
+				<< std::setw(15) << r.throughput
+				<< std::setw(15) << r.memory / (1024 * 1024)
+				<< std::endl;
+		}
+	};
+
+	if (format == "table") {
+		cout << "p=" << p << ", " << warmup << " warm-up and " << reps << " timed runs per case\n"
+			<< std::setw(15) << "Path"
+			<< std::setw(20) << "Engine"
+			<< std::setw(15) << "Length"
+			<< std::setw(15) << "p-variation"
+			<< std::setw(15) << "Median secs"
+			<< std::setw(15) << "p95 secs"
+			<< std::setw(15) << "Points/sec"
+			<< std::setw(15) << "Peak MiB"
+			<< "\n";
+	}
+
+	for (size_t steps = min_size; steps <= max_size; steps *= 10) {
+		std::vector<std::pair<std::string, std::vector<double> > > paths;
+		paths.emplace_back("brownian", make_brownian_path(1 / std::sqrt(double(steps)), steps, 1));
+		paths.emplace_back("intermittent", make_intermittent_path(steps, 0.6, 2));
+		paths.emplace_back("periodic", make_periodic_path(steps));
+		for (const auto & named_path : paths) {
+			const auto & path = named_path.second;
+			report(bench(named_path.first, "p_var" + index_layout, path.size(), warmup, reps, [&]() {
+				return p_var(path, p).value;
+			}));
+			report(bench(named_path.first, "p_var_value" + index_layout, path.size(), warmup, reps, [&]() {
+				return p_var_ns::p_var_value(path, p);
+			}));
+			report(bench(named_path.first, "pvar", path.size(), warmup, reps, [&]() {
+				return p_var_real::pvar(path, p);
+			}));
+		}
+		paths.clear();
+
+		std::vector<vecRd> path = make_brownian_path_Rd(steps, 3);
+		report(bench("brownian_R3", "p_var" + index_layout, path.size(), warmup, reps, [&]() {
+			return p_var(path, p).value;
+		}));
+		report(bench("brownian_R3", "p_var_value" + index_layout, path.size(), warmup, reps, [&]() {
+			return p_var_ns::p_var_value(path, p);
+		}));
+
+	}
+
+	if (format == "csv") {
+		cout << "path,engine,size,value,median_secs,p95_secs,points_per_sec,peak_bytes\n";
+		cout << std::setprecision(10);
+		for (const auto & r : results) {
+			cout << r.path << "," << r.engine << "," << r.size << "," << r.value << ","
+				<< r.median << "," << r.p95 << "," << r.throughput << "," << r.memory << "\n";
+		}
+	}
+	else if (format == "json") {
+		cout << "{\"p\": " << p << ", \"warmup\": " << warmup << ", \"reps\": " << reps << ", \"results\": [\n";
+		cout << std::setprecision(10);
+		for (size_t k = 0; k < results.size(); k++) {
+			const auto & r = results[k];
+			cout << "  {\"path\": \"" << r.path << "\", \"engine\": \"" << r.engine
+				<< "\", \"size\": " << r.size << ", \"value\": " << r.value
+				<< ", \"median_secs\": " << r.median << ", \"p95_secs\": " << r.p95
+				<< ", \"points_per_sec\": " << r.throughput << ", \"peak_bytes\": " << r.memory << "}"
+				<< (k + 1 < results.size() ? "," : "") << "\n";
+		}
+		cout << "]}\n";
+	}
+
+	return 0;
+}
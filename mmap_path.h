@@ -0,0 +1,351 @@
+// Copyright 2018 Alexey Korepanov & Terry Lyons
+#pragma once
+
+/*
+ * mmap_path: read-only memory mapping of a flat binary file of points,
+ * e.g. doubles or std::array<double, d>, in native byte order.
+ *
+ * Usage:
+ *   mmap_path<double> path("prices.bin");
+ *   double pv = p_var_real::pvar(path.data(), path.size(), p);
+ *   auto pv = p_var(path.begin(), path.end(), p, dist);
+ * No data is copied: the points are read directly from the page cache.
+ * The mapping is advised to be read sequentially.
+ * Throws std::system_error if the file cannot be mapped.
+ *
+ * scratch_array: a writable array of trivially copyable values in a memory mapped
+ * temporary file, which is deleted when the array is destroyed, e.g.
+ *   scratch_array<double> a("/tmp");
+ *   a.assign(n, 0.);
+ * Its pages can be written back and dropped from memory by the system,
+ * and release() drops them right away; they are read back when used again.
+ * Both are used by p_var_out_of_core.h.
+ */
+
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#ifdef _WIN32
+// keep std::min and std::max usable
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#endif
+
+namespace p_var_ns {
+
+#ifdef _WIN32
+namespace internal {
+	// Drop the pages of a view of a file from the memory of the process by unmapping it
+	// and mapping it again, at the same address if possible; written pages stay in the file.
+	// (VirtualUnlock does not drop unlocked pages, and DiscardVirtualMemory and OfferVirtualMemory
+	// are only for private memory, they would lose the contents of a file mapping.)
+	inline void * remap_view(HANDLE mapping, void * addr, DWORD access) {
+		UnmapViewOfFile(addr);
+		void * new_addr = MapViewOfFileEx(mapping, access, 0, 0, 0, addr);
+		if (new_addr == NULL) {
+			new_addr = MapViewOfFile(mapping, access, 0, 0, 0);
+		}
+		if (new_addr == NULL) {
+			throw std::system_error(int(GetLastError()), std::system_category(), "cannot map a file again");
+		}
+		return new_addr;
+	}
+}
+#endif
+
+template <typename point_t>
+class mmap_path {
+	static_assert(std::is_trivially_copyable<point_t>::value, "points must be stored as raw bytes");
+
+public:
+	explicit mmap_path(const std::string & file_name) {
+#ifdef _WIN32
+		file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+				OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			fail("cannot open " + file_name);
+		}
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size)) {
+			fail("cannot get size of " + file_name);
+		}
+		bytes = size_t(file_size.QuadPart);
+		if (bytes > 0) {
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping == NULL) {
+				fail("cannot map " + file_name);
+			}
+			addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (addr == NULL) {
+				fail("cannot map " + file_name);
+			}
+		}
+#else
+		fd = open(file_name.c_str(), O_RDONLY);
+		if (fd < 0) {
+			fail("cannot open " + file_name);
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			fail("cannot get size of " + file_name);
+		}
+		bytes = size_t(st.st_size);
+		if (bytes > 0) {
+			addr = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+			if (addr == MAP_FAILED) {
+				addr = nullptr;
+				fail("cannot map " + file_name);
+			}
+			madvise(addr, bytes, MADV_SEQUENTIAL);
+		}
+#endif
+	}
+
+	mmap_path(const mmap_path &) = delete;
+	mmap_path & operator=(const mmap_path &) = delete;
+
+	~mmap_path() {
+		close();
+	}
+
+	// number of whole points in the file
+	size_t size() const {
+		return bytes / sizeof(point_t);
+	}
+	const point_t * data() const {
+		return static_cast<const point_t *>(addr);
+	}
+	const point_t * begin() const {
+		return data();
+	}
+	const point_t * end() const {
+		return data() + size();
+	}
+	const point_t & operator[](size_t k) const {
+		return data()[k];
+	}
+
+	// drop the mapped pages from the memory of the process, they are read again when needed;
+	// on Windows the view is mapped again, possibly at another address, so data() must be called again
+	void release() const {
+		if (addr != nullptr) {
+#ifdef _WIN32
+			addr = internal::remap_view(mapping, addr, FILE_MAP_READ);
+#else
+			madvise(addr, bytes, MADV_DONTNEED);
+#endif
+		}
+	}
+
+private:
+	void close() {
+#ifdef _WIN32
+		if (addr != nullptr) {
+			UnmapViewOfFile(addr);
+		}
+		if (mapping != NULL) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (addr != nullptr) {
+			munmap(addr, bytes);
+		}
+		if (fd >= 0) {
+			::close(fd);
+		}
+		fd = -1;
+#endif
+		addr = nullptr;
+	}
+
+	[[noreturn]] void fail(const std::string & what) {
+#ifdef _WIN32
+		int code = int(GetLastError());
+#else
+		int code = errno;
+#endif
+		close();
+		throw std::system_error(code, std::system_category(), what);
+	}
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	mutable void * addr = nullptr; // changed by release()
+#else
+	int fd = -1;
+	void * addr = nullptr;
+#endif
+	size_t bytes = 0;
+};
+
+template <typename value_t>
+class scratch_array {
+	static_assert(std::is_trivially_copyable<value_t>::value, "values must be stored as raw bytes");
+
+public:
+	// the temporary file is created in the directory dir
+	explicit scratch_array(const std::string & dir) : dir(dir) {}
+
+	scratch_array(const scratch_array &) = delete;
+	scratch_array & operator=(const scratch_array &) = delete;
+
+	~scratch_array() {
+		unmap();
+	}
+
+	// n copies of value, the file is resized and mapped again
+	void assign(size_t n, const value_t & value) {
+		unmap();
+		count = n;
+		if (n == 0) {
+			return;
+		}
+		map(n * sizeof(value_t));
+		// the new file is filled with zero bytes, other values are written
+		const unsigned char * bytes_of_value = reinterpret_cast<const unsigned char *>(&value);
+		if (std::any_of(bytes_of_value, bytes_of_value + sizeof(value_t), [](unsigned char c) { return c != 0; })) {
+			for (size_t k = 0; k < n; k++) {
+				data()[k] = value;
+			}
+		}
+	}
+
+	size_t size() const {
+		return count;
+	}
+	value_t * data() {
+		return static_cast<value_t *>(addr);
+	}
+	const value_t * data() const {
+		return static_cast<const value_t *>(addr);
+	}
+	value_t & operator[](size_t k) {
+		return data()[k];
+	}
+	const value_t & operator[](size_t k) const {
+		return data()[k];
+	}
+
+	// drop the pages from the memory of the process, they are written to the file if needed;
+	// on Windows the view is mapped again, possibly at another address, so data() must be called again
+	void release() {
+		if (addr != nullptr) {
+#ifdef _WIN32
+			addr = internal::remap_view(mapping, addr, FILE_MAP_WRITE);
+#else
+			madvise(addr, bytes, MADV_DONTNEED);
+#endif
+		}
+	}
+
+private:
+	void map(size_t size) {
+		bytes = size;
+#ifdef _WIN32
+		char file_name[MAX_PATH];
+		if (GetTempFileNameA(dir.c_str(), "pv", 0, file_name) == 0) {
+			fail("cannot create a temporary file in " + dir);
+		}
+		file = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+				FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			fail("cannot create a temporary file in " + dir);
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+				DWORD(uint64_t(bytes) >> 32), DWORD(uint64_t(bytes) & 0xffffffffu), NULL);
+		if (mapping == NULL) {
+			fail("cannot map a temporary file");
+		}
+		addr = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+		if (addr == NULL) {
+			fail("cannot map a temporary file");
+		}
+#else
+		std::string file_name = dir + "/p_var_scratch_XXXXXX";
+		fd = mkstemp(&file_name[0]);
+		if (fd < 0) {
+			fail("cannot create a temporary file in " + dir);
+		}
+		// the file is deleted when closed
+		unlink(file_name.c_str());
+		if (ftruncate(fd, off_t(bytes)) != 0) {
+			fail("cannot resize a temporary file");
+		}
+		addr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED) {
+			addr = nullptr;
+			fail("cannot map a temporary file");
+		}
+#endif
+	}
+
+	void unmap() {
+#ifdef _WIN32
+		if (addr != nullptr) {
+			UnmapViewOfFile(addr);
+		}
+		if (mapping != NULL) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (addr != nullptr) {
+			munmap(addr, bytes);
+		}
+		if (fd >= 0) {
+			::close(fd);
+		}
+		fd = -1;
+#endif
+		addr = nullptr;
+		bytes = 0;
+	}
+
+	[[noreturn]] void fail(const std::string & what) {
+#ifdef _WIN32
+		int code = int(GetLastError());
+#else
+		int code = errno;
+#endif
+		unmap();
+		count = 0;
+		throw std::system_error(code, std::system_category(), what);
+	}
+
+	std::string dir;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	void * addr = nullptr;
+#else
+	int fd = -1;
+	void * addr = nullptr;
+#endif
+	size_t bytes = 0;
+	size_t count = 0;
+};
+
+} // namespace p_var_ns
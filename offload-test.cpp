@@ -0,0 +1,65 @@
+// Copyright 2018 Alexey Korepanov & Terry Lyons
+
+// Test and benchmark of pvar_batch_offload against the CPU implementation pvar_batch (make offload).
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+
+#include "p_var_real.h"
+#include "p_var_offload.h"
+
+int main() {
+	using std::cout;
+
+	cout << std::setw(15) << "Paths"
+		<< std::setw(15) << "Length"
+		<< std::setw(15) << "p"
+		<< std::setw(15) << "CPU secs"
+		<< std::setw(15) << "Offload secs"
+		<< std::setw(15) << "Error"
+		<< "\n";
+
+	std::default_random_engine generator(1);
+	for (size_t length : {size_t(1000), size_t(10000)}) {
+		size_t paths = 10000000 / length;
+		std::uniform_int_distribution<size_t> path_length(1, 2 * length);
+		std::normal_distribution<double> gauss(0.0, 1 / std::sqrt(double(length)));
+		std::vector<double> values;
+		std::vector<size_t> offsets(1, 0);
+		for (size_t i = 0; i < paths; i++) {
+			size_t n = path_length(generator);
+			double x = 0;
+			for (size_t j = 0; j < n; j++) {
+				values.push_back(x);
+				x += gauss(generator);
+			}
+			offsets.push_back(values.size());
+		}
+
+		for (double p : {1.5, 2.5, 3.}) {
+			auto clock_begin = std::chrono::steady_clock::now();
+			std::vector<double> pvs = p_var_real::pvar_batch(values, offsets, p);
+			auto clock_end = std::chrono::steady_clock::now();
+			std::vector<double> pvs_offload = p_var_real::pvar_batch_offload(values, offsets, p);
+			auto offload_clock_end = std::chrono::steady_clock::now();
+
+			double err = 0;
+			for (size_t i = 0; i < paths; i++) {
+				err = std::max(err, std::abs(pvs_offload[i] - pvs[i]) / std::max(1., pvs[i]));
+			}
+			cout << std::setw(15) << paths
+				<< std::setw(15) << length
+				<< std::setw(15) << p
+				<< std::setw(15) << std::chrono::duration<double>(clock_end - clock_begin).count()
+				<< std::setw(15) << std::chrono::duration<double>(offload_clock_end - clock_end).count()
+				<< std::setw(15) << err
+				<< "\n";
+		}
+	}
+	return 0;
+}
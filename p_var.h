@@ -9,14 +9,54 @@
  *   auto pv =  p_var(path, p, dist)
  * where path is a vector/array, dist is a distance function and p >= 1 is real, or
  *   auto pv = p_var(iterator_begin, iterator_end, p, dist)
- * if path is in a container with random access iterators.
+ * if path is in a container with random access iterators, or is any contiguous
+ * range given by pointers, e.g. a memory mapped file (see mmap_path.h); nothing is copied.
+ * Containers are taken by reference; strided_view and soa_view (see below) present
+ * columns of a matrix or separate coordinate arrays as paths without copying.
  * Then:
  *   pv.value is the p-variation of the path,
  *   pv.points is the maximising subsequence in a vector<size_t>.
+ * For a whole grid of exponents ps (any container of reals), use
+ *   auto pvs = p_var_multi(path, ps, dist)
+ * which returns a vector with one such result per exponent and is faster than
+ * calling p_var for each exponent separately.
+ * If only pv.value is needed, p_var_value(path, p, dist) returns it directly,
+ * skipping the maximising sequence and saving memory.
+ * p_var_prefix(path, p, dist) returns the p-variation of every prefix of the path, in one pass.
+ * p_var_exceeds(path, p, threshold, dist) tells whether the p-variation is greater than threshold,
+ * and stops as soon as the answer is known.
+ * When calling p_var many times, pass a p_var_workspace<real_t, dist_t> ws as the last argument,
+ *   auto & pv = p_var(path, p, dist, ws)
+ * so that memory is reused between calls; pv then refers to ws.ret.
+ * The only gain is the avoided allocation, so it is measurable only for paths of a few points:
+ * in TEST 10 of test.cpp, paths of 4 points take about 30% less time with a workspace,
+ * while for paths of 100 points both take the same time within noise.
+ * With p_var_workspace<double, double, float> the spatial index is stored in float, rounded up.
+ * For expensive metrics, pass a p_var_dist_cache<dist_t> cache instead,
+ *   auto pv = p_var(path, p, dist, cache)
+ * so that each distance is computed only once; cache.hits() and cache.misses() count lookups.
+ * For points std::array<T, D> with a fixed small D, p_var<D>(path, p, dist) loads the point j
+ * once per step; so far it is not measurably faster than p_var, see FIXED DIMENSION below.
+ * For the p-variation of many sub-intervals [a, b] of one real path, use p_var_real::pvar_index;
+ * for other paths there is no such index: p_var on each sub-interval builds the spatial index
+ * of that sub-interval again, and the reuse of work between sub-intervals is out of scope.
+ * p_var_approx(path, p, dist, options) returns a lower and an upper bound of the p-variation,
+ * refined until they are within a tolerance or a time budget is spent, see APPROXIMATION below.
+ * For a path which arrives one point at a time, use p_var_stream,
+ * or p_var_window for the p-variation over a trailing window, see below.
+ * Compile with -DP_VAR_BLOCKED_INDEX for a spatial index layout with better locality
+ * on very long paths, see blocked_dyadic_index.
+ * Compile with -DP_VAR_STATS to count distance calls and skips in p_var_stats(), see below.
+ * Pass a p_var_prefilter as the last argument to remove repeated (and, for normed spaces,
+ * collinear) points before the computation.
+ * For paths which do not fit into memory together with the working memory, see p_var_out_of_core.h.
+ * To store a path in a file together with its spatial index, which does not depend on p, see p_var_file.h.
  * See test.cpp for examples and benchmarks.
  *
  * Notes:
  * 1. Return type for p-varitaion is that of std::pow(dist(), p).
+ *    If p is a compile time constant such as 3 or 2.5, pass power<3>() or power<5, 2>()
+ *    to avoid calling std::pow.
  * 2. We do not take p-th root of the sum of increments.
  * 3. p-variation of an empty path is negative infinity.
  * 4. p-variation of a path with one point is zero.
@@ -30,6 +70,15 @@
 #include <numeric>
 #include <algorithm>
 #include <iterator>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <chrono>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace p_var_ns {
 
@@ -45,12 +94,103 @@ namespace internal {
 	template <typename iterator_t>
 	using iterator_value_t = typename std::iterator_traits<iterator_t>::value_type;
 	template <typename container_t>
-	using container_iterator_value_t = iterator_value_t<typename container_t::iterator>;
+	using container_iterator_value_t = iterator_value_t<decltype(std::cbegin(std::declval<const container_t &>()))>;
+
+	// path_dist(a, b) = dist(path[a], path[b]) for a path given by iterators;
+	// many() measures the points a[0..count) against b at once when dist has
+	//   void many(const point_t * const * a, size_t count, const point_t & b, dist_t * out)
+	// (e.g. euclidean_dist) and the path stores its points, see dist_many
+	template <typename const_iterator_t, typename func_t>
+	struct iterator_dist {
+		const_iterator_t path_begin;
+		const func_t & dist;
+
+		auto operator()(size_t a, size_t b) const {
+			return dist(*(path_begin + a), *(path_begin + b));
+		}
+
+		template <typename dist_t, typename f_t = func_t, typename point_t = iterator_value_t<const_iterator_t> >
+		auto many(const size_t * a, size_t count, size_t b, dist_t * out) const ->
+		typename std::enable_if<std::is_lvalue_reference<decltype(*path_begin)>::value,
+			decltype(std::declval<const f_t &>().many(std::declval<const point_t * const *>(), count, std::declval<const point_t &>(), out))>::type
+		{
+			std::array<const point_t *, 8 * sizeof(size_t)> points;
+			for (size_t done = 0; done < count; done += points.size()) {
+				size_t c = std::min(count - done, points.size());
+				for (size_t i = 0; i < c; i++) {
+					points[i] = &*(path_begin + a[done + i]);
+				}
+				dist.many(points.data(), c, *(path_begin + b), out + done);
+			}
+		}
+	};
 }
 
+// *** STATISTICS ***
+// Compiled with -DP_VAR_STATS, the computations count what they do in p_var_stats(),
+// one p_var_stats_t per thread, accumulated until reset():
+// * dist_calls: calls of path_dist, in the index and in the search;
+// * steps: points j for which the p-variation up to j was computed;
+// * m_iterations, max_m_iterations: iterations of the search over m for all j, and for one j;
+// * skips[n]: dyadic blocks of level n skipped by the search.
+// Without P_VAR_STATS nothing is counted and there is no overhead.
+#ifndef P_VAR_STAT
+#ifdef P_VAR_STATS
+#define P_VAR_STAT(statement) statement
+#else
+#define P_VAR_STAT(statement)
+#endif
+#endif
+
+#ifdef P_VAR_STATS
+struct p_var_stats_t {
+	size_t dist_calls = 0;
+	size_t steps = 0;
+	size_t m_iterations = 0;
+	size_t max_m_iterations = 0;
+	std::array<size_t, 8 * sizeof(size_t)> skips{};
+
+	void reset() {
+		*this = p_var_stats_t();
+	}
+};
+
+inline p_var_stats_t & p_var_stats() {
+	static thread_local p_var_stats_t stats;
+	return stats;
+}
+#endif
+
 // forward declaration of the p-variation backbone computation
 template <typename func_t, typename power_t>
 auto p_var_backbone(size_t path_size, power_t p, func_t path_dist);
+template <typename func_t, typename power_iterator_t>
+auto p_var_multi_backbone(size_t path_size, power_iterator_t p_begin, power_iterator_t p_end, func_t path_dist);
+template <typename real_t, typename dist_t = real_t, typename bound_t = dist_t>
+struct p_var_workspace;
+template <typename func_t, typename power_t, typename workspace_t>
+const auto & p_var_backbone(size_t path_size, power_t p, func_t path_dist, workspace_t & ws);
+template <typename func_t, typename power_t>
+auto p_var_value_backbone(size_t path_size, power_t p, func_t path_dist);
+template <typename func_t, typename power_t, typename real_t>
+void p_var_prefix_backbone(size_t path_size, power_t p, func_t path_dist, real_t * out);
+template <typename func_t, typename power_t, typename threshold_t>
+bool p_var_exceeds_backbone(size_t path_size, power_t p, threshold_t threshold, func_t path_dist);
+template <typename func_t, typename power_t>
+auto p_var_prefix_backbone(size_t path_size, power_t p, func_t path_dist);
+template <typename dist_t>
+class p_var_dist_cache;
+
+// which points p_var(path, p, dist, filter) removes before the computation, see PRE-FILTER below
+struct p_var_prefilter {
+	// consecutive repeats, i.e. points at distance 0 from the previous one; valid for any metric
+	bool duplicates = true;
+	// points on the segment between their neighbours; only valid if path consists of reals
+	// or vectors of reals, and dist(a, b) is a norm of b - a
+	bool collinear = false;
+};
+template <typename const_iterator_t, typename func_t>
+std::vector<size_t> p_var_prefilter_points(const_iterator_t path_begin, const_iterator_t path_end, func_t dist, p_var_prefilter filter);
 
 
 // *** INTERFACE ***
@@ -58,17 +198,120 @@ auto p_var_backbone(size_t path_size, power_t p, func_t path_dist);
 template <typename power_t, typename const_iterator_t,
 	 typename func_t = internal::dist_func_t<internal::iterator_value_t<const_iterator_t> > >
 auto p_var(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist = internal::dist) {
-	auto path_dist = [&path_begin,&dist](size_t a, size_t b) {
-		return dist(*(path_begin + a), *(path_begin + b));
-	};
+	internal::iterator_dist<const_iterator_t, func_t> path_dist{path_begin, dist};
 	return p_var_backbone(path_end - path_begin, p, path_dist);
 }
-// vector or array or else
+// vector or array or view or else, taken by reference
 template <typename power_t, typename vector_t, typename func_t = internal::dist_func_t<internal::container_iterator_value_t<vector_t> > >
-auto p_var(vector_t path, power_t p, func_t dist = internal::dist) {
+auto p_var(const vector_t & path, power_t p, func_t dist = internal::dist) {
 	return p_var(std::cbegin(path), std::cend(path), p, dist);
 }
 
+// value only, without the maximising sequence: faster and uses less memory
+template <typename power_t, typename const_iterator_t,
+	 typename func_t = internal::dist_func_t<internal::iterator_value_t<const_iterator_t> > >
+auto p_var_value(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist = internal::dist) {
+	internal::iterator_dist<const_iterator_t, func_t> path_dist{path_begin, dist};
+	return p_var_value_backbone(path_end - path_begin, p, path_dist);
+}
+template <typename power_t, typename vector_t, typename func_t = internal::dist_func_t<internal::container_iterator_value_t<vector_t> > >
+auto p_var_value(const vector_t & path, power_t p, func_t dist = internal::dist) {
+	return p_var_value(std::cbegin(path), std::cend(path), p, dist);
+}
+
+// p-variation of every prefix: element j is the p-variation of the points 0,...,j,
+// computed in one pass, the same as p_var(path_begin, path_begin + j + 1, p, dist).value.
+// The last form writes the path_end - path_begin values to out instead.
+template <typename power_t, typename const_iterator_t,
+	 typename func_t = internal::dist_func_t<internal::iterator_value_t<const_iterator_t> > >
+auto p_var_prefix(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist = internal::dist) {
+	internal::iterator_dist<const_iterator_t, func_t> path_dist{path_begin, dist};
+	return p_var_prefix_backbone(path_end - path_begin, p, path_dist);
+}
+template <typename power_t, typename vector_t, typename func_t = internal::dist_func_t<internal::container_iterator_value_t<vector_t> > >
+auto p_var_prefix(const vector_t & path, power_t p, func_t dist = internal::dist) {
+	return p_var_prefix(std::cbegin(path), std::cend(path), p, dist);
+}
+template <typename power_t, typename const_iterator_t, typename func_t, typename real_t>
+void p_var_prefix(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist, real_t * out) {
+	internal::iterator_dist<const_iterator_t, func_t> path_dist{path_begin, dist};
+	p_var_prefix_backbone(path_end - path_begin, p, path_dist, out);
+}
+
+// whether the p-variation is greater than threshold, the same as p_var_value(path, p, dist) > threshold,
+// stopping as soon as the answer is known, see p_var_exceeds_backbone
+template <typename power_t, typename threshold_t, typename const_iterator_t,
+	 typename func_t = internal::dist_func_t<internal::iterator_value_t<const_iterator_t> > >
+bool p_var_exceeds(const_iterator_t path_begin, const_iterator_t path_end, power_t p, threshold_t threshold, func_t dist = internal::dist) {
+	internal::iterator_dist<const_iterator_t, func_t> path_dist{path_begin, dist};
+	return p_var_exceeds_backbone(path_end - path_begin, p, threshold, path_dist);
+}
+template <typename power_t, typename threshold_t, typename vector_t,
+	 typename func_t = internal::dist_func_t<internal::container_iterator_value_t<vector_t> > >
+bool p_var_exceeds(const vector_t & path, power_t p, threshold_t threshold, func_t dist = internal::dist) {
+	return p_var_exceeds(std::cbegin(path), std::cend(path), p, threshold, dist);
+}
+
+// with a workspace: repeated calls do not allocate memory once ws has grown to the longest path;
+// the result is a reference to ws.ret, valid until the next use of ws
+template <typename power_t, typename const_iterator_t, typename func_t, typename real_t, typename dist_t, typename bound_t>
+const auto & p_var(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist, p_var_workspace<real_t, dist_t, bound_t> & ws) {
+	internal::iterator_dist<const_iterator_t, func_t> path_dist{path_begin, dist};
+	return p_var_backbone(path_end - path_begin, p, path_dist, ws);
+}
+template <typename power_t, typename vector_t, typename func_t, typename real_t, typename dist_t, typename bound_t>
+const auto & p_var(const vector_t & path, power_t p, func_t dist, p_var_workspace<real_t, dist_t, bound_t> & ws) {
+	return p_var(std::cbegin(path), std::cend(path), p, dist, ws);
+}
+
+// with a distance cache, for expensive metrics: each pair of points is measured at most once
+// as long as the cache is large enough, see p_var_dist_cache below
+template <typename power_t, typename const_iterator_t, typename func_t, typename dist_t>
+auto p_var(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist, p_var_dist_cache<dist_t> & cache) {
+	cache.clear();
+	auto path_dist = [&path_begin,&dist,&cache](size_t a, size_t b) {
+		return cache(a, b, [&path_begin,&dist,a,b]() {
+			return dist(*(path_begin + a), *(path_begin + b));
+		});
+	};
+	return p_var_backbone(path_end - path_begin, p, path_dist);
+}
+template <typename power_t, typename vector_t, typename func_t, typename dist_t>
+auto p_var(const vector_t & path, power_t p, func_t dist, p_var_dist_cache<dist_t> & cache) {
+	return p_var(std::cbegin(path), std::cend(path), p, dist, cache);
+}
+
+// with a pre-filter removing points which cannot change the p-variation,
+// .points still refer to the original path
+template <typename power_t, typename const_iterator_t, typename func_t>
+auto p_var(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist, p_var_prefilter filter) {
+	std::vector<size_t> kept = p_var_prefilter_points(path_begin, path_end, dist, filter);
+	auto path_dist = [&path_begin,&dist,&kept](size_t a, size_t b) {
+		return dist(*(path_begin + kept[a]), *(path_begin + kept[b]));
+	};
+	auto ret = p_var_backbone(kept.size(), p, path_dist);
+	for (auto & point : ret.points) {
+		point = kept[point];
+	}
+	return ret;
+}
+template <typename power_t, typename vector_t, typename func_t>
+auto p_var(const vector_t & path, power_t p, func_t dist, p_var_prefilter filter) {
+	return p_var(std::cbegin(path), std::cend(path), p, dist, filter);
+}
+
+// many exponents at once: ps is a container of exponents, returns a vector of results
+template <typename powers_t, typename const_iterator_t,
+	 typename func_t = internal::dist_func_t<internal::iterator_value_t<const_iterator_t> > >
+auto p_var_multi(const_iterator_t path_begin, const_iterator_t path_end, const powers_t & ps, func_t dist = internal::dist) {
+	internal::iterator_dist<const_iterator_t, func_t> path_dist{path_begin, dist};
+	return p_var_multi_backbone(path_end - path_begin, std::cbegin(ps), std::cend(ps), path_dist);
+}
+template <typename powers_t, typename vector_t, typename func_t = internal::dist_func_t<internal::container_iterator_value_t<vector_t> > >
+auto p_var_multi(const vector_t & path, const powers_t & ps, func_t dist = internal::dist) {
+	return p_var_multi(std::cbegin(path), std::cend(path), ps, dist);
+}
+
 
 // *** BACKBONE ***
 // Input:
@@ -82,35 +325,132 @@ auto p_var(vector_t path, power_t p, func_t dist = internal::dist) {
 // * .value: real, \max \sum_k path_dist(a_k, a_{k+1})^p
 //            over all increasing subsequences a_k of 0,...,path_size-1
 // * .points: vector<size_t>, the maximizing subsequence a_k
-template <typename func_t, typename power_t>
-auto p_var_backbone(size_t path_size, power_t p, func_t path_dist)
-{
-        typedef decltype(path_dist(0, 0)) dist_t;
-        typedef decltype(std::pow(path_dist(0, 0), p)) real_t;
+template <typename real_t>
+struct p_var_ret_t {
+	real_t value;
+	std::vector<size_t> points;
+};
 
-	struct ret_t {
-		real_t value;
-		std::vector<size_t> points;
-	} ret;
+// p given at compile time as the fraction num/den, e.g. power<3>() or power<5, 2>() for p = 2.5:
+//   auto pv = p_var(path, power<5, 2>(), dist)
+// Then d^p and x^(1/p) are computed by multiplications and sqrt/cbrt instead of std::pow.
+// It converts to double, so it can be used wherever p is.
+template <int num, int den = 1>
+struct power {
+	static_assert(num > 0 && den > 0, "p must be positive");
+	constexpr operator double() const { return double(num) / den; }
+};
 
-	if (path_size == 0) {
-		ret.value = -std::numeric_limits<real_t>::infinity();
-		return ret;
+namespace internal {
+	template <int n, typename real_t>
+	real_t int_pow(real_t x);
+	template <int n, typename real_t>
+	real_t int_root(real_t x);
+
+	// x^n by squaring, dispatched on whether n is even
+	template <typename real_t>
+	real_t int_pow_step(real_t, std::integral_constant<int, 0>, std::true_type) {
+		return real_t(1);
 	}
-	else if (path_size == 1) {
-		ret.value = 0;
-		ret.points.push_back(0);
-		return ret;
+	template <int n, typename real_t>
+	real_t int_pow_step(real_t x, std::integral_constant<int, n>, std::true_type) {
+		real_t y = int_pow<n / 2>(x);
+		return y * y;
+	}
+	template <int n, typename real_t>
+	real_t int_pow_step(real_t x, std::integral_constant<int, n>, std::false_type) {
+		return x * int_pow<n - 1>(x);
+	}
+	template <int n, typename real_t>
+	real_t int_pow(real_t x) {
+		return int_pow_step(x, std::integral_constant<int, n>(), std::integral_constant<bool, n % 2 == 0>());
 	}
 
-	// running p-variation
-	std::vector<real_t> run_p_var(path_size, 0);
+	// x^(1/n), dispatched on how it is computed: 1 for n = 1, 2 for even n, 3 for n = 3, 0 otherwise
+	template <int n>
+	using int_root_method = std::integral_constant<int, n == 1 ? 1 : n % 2 == 0 ? 2 : n == 3 ? 3 : 0>;
+	template <int n, typename real_t>
+	real_t int_root_step(real_t x, std::integral_constant<int, 1>) {
+		return x;
+	}
+	template <int n, typename real_t>
+	real_t int_root_step(real_t x, std::integral_constant<int, 2>) {
+		return int_root<n / 2>(std::sqrt(x));
+	}
+	template <int n, typename real_t>
+	real_t int_root_step(real_t x, std::integral_constant<int, 3>) {
+		return std::cbrt(x);
+	}
+	template <int n, typename real_t>
+	real_t int_root_step(real_t x, std::integral_constant<int, 0>) {
+		return std::pow(x, real_t(1) / n);
+	}
+	template <int n, typename real_t>
+	real_t int_root(real_t x) {
+		return int_root_step<n>(x, int_root_method<n>());
+	}
 
-	size_t s = path_size - 1;
+	// x^p
+	template <typename real_t, typename power_t>
+	auto pow_p(real_t x, power_t p) {
+		return std::pow(x, p);
+	}
+	template <typename real_t, int num, int den>
+	auto pow_p(real_t x, power<num, den>) {
+		typedef decltype(std::pow(x, 1.)) ret_t;
+		return int_pow<num>(int_root<den>(ret_t(x)));
+	}
+
+	// x^(1/p)
+	template <typename real_t, typename power_t>
+	auto root_p(real_t x, power_t p) {
+		return std::pow(x, 1. / p);
+	}
+	template <typename real_t, int num, int den>
+	auto root_p(real_t x, power<num, den>) {
+		typedef decltype(std::pow(x, 1.)) ret_t;
+		return int_pow<den>(int_root<num>(ret_t(x)));
+	}
+} // namespace internal
+
+namespace internal {
+	// the least bound_t which is >= d, dispatched on whether bound_t is dist_t
+	template <typename bound_t, typename dist_t>
+	bound_t round_up(dist_t d, std::true_type) {
+		return d;
+	}
+	template <typename bound_t, typename dist_t>
+	bound_t round_up(dist_t d, std::false_type) {
+		// rounding d * (1 + epsilon) to nearest is enough for normal numbers,
+		// nextafter is only needed near zero
+		bound_t b = bound_t(d * (1 + dist_t(std::numeric_limits<bound_t>::epsilon())));
+		if (dist_t(b) < d) {
+			b = std::nextafter(b, std::numeric_limits<bound_t>::infinity());
+		}
+		return b;
+	}
+	template <typename bound_t, typename dist_t>
+	bound_t round_up(dist_t d) {
+		return round_up<bound_t>(d, std::is_same<bound_t, dist_t>());
+	}
 
-	size_t N = 1;
-	while (s >> N) {
-		N++;
+	// out[i] = path_dist(a[i], b) for i < count, by path_dist.many(a, count, b, out)
+	// if path_dist has it (see iterator_dist), otherwise one at a time
+	template <typename func_t, typename dist_t>
+	auto dist_many(const func_t & path_dist, const size_t * a, size_t count, size_t b, dist_t * out, int) ->
+	decltype(path_dist.many(a, count, b, out))
+	{
+		return path_dist.many(a, count, b, out);
+	}
+	template <typename func_t, typename dist_t>
+	void dist_many(const func_t & path_dist, const size_t * a, size_t count, size_t b, dist_t * out, long) {
+		for (size_t i = 0; i < count; i++) {
+			out[i] = path_dist(a[i], b);
+		}
+	}
+	template <typename func_t, typename dist_t>
+	void dist_many(const func_t & path_dist, const size_t * a, size_t count, size_t b, dist_t * out) {
+		dist_many(path_dist, a, count, b, out, 0);
 	}
 
 	// spatial index:
@@ -120,41 +460,180 @@ auto p_var_backbone(size_t path_size, power_t p, func_t path_dist)
 	// * choose k = ind_k(j, n) so that it is somewhere in the middle of [a,b)
 	// * compute ind(j, n) = max { path_dist(k, m) : a <= m < b}
 	// * store ind(j, n) in a flat array ind[] at position ind_n(j,n) with a suitable function ind_n
-	std::vector<dist_t> ind(s, 0.0);
-	auto ind_n = [s](size_t j, size_t n) {
-		return (s >> n) + (j >> n);
-	};
-	auto ind_k = [s](size_t j, size_t n) {
-		return std::min<size_t>(((j >> n) << n) + (1 << (n-1)), s);
+	// The index does not depend on p.
+	// The bounds are stored as bound_t, e.g. float for double distances, rounded up:
+	// they are only used for skipping, so an upper bound is as good as the exact maximum.
+	// storage_t is a vector-like array of bound_t with assign() and operator[].
+	template <typename dist_t, typename bound_t = dist_t, typename storage_t = std::vector<bound_t> >
+	struct dyadic_index {
+		size_t s = 0;
+		size_t N = 1;
+		storage_t ind;
+
+		dyadic_index() = default;
+		explicit dyadic_index(size_t path_size) {
+			reset(path_size);
+		}
+		// ind is constructed from storage_arg, e.g. the directory of a scratch file
+		template <typename storage_arg_t>
+		dyadic_index(size_t path_size, const storage_arg_t & storage_arg) : ind(storage_arg) {
+			reset(path_size);
+		}
+
+		// empty index for a path with path_size >= 1 points, keeps allocated memory
+		void reset(size_t path_size) {
+			s = path_size - 1;
+			N = 1;
+			while (s >> N) {
+				N++;
+			}
+			ind.assign(s, bound_t(0));
+		}
+
+		size_t ind_n(size_t j, size_t n) const {
+			return (s >> n) + (j >> n);
+		}
+		size_t ind_k(size_t j, size_t n) const {
+			return std::min<size_t>(((j >> n) << n) + (1 << (n-1)), s);
+		}
+		// the last level n interval is not stored when its second half is empty,
+		// in that case the level n-1 interval is used instead
+		bool covers(size_t j, size_t n) const {
+			return !(j >> n == s >> n && (s >> (n-1)) % 2 == 0);
+		}
+		bound_t bound(size_t j, size_t n) const {
+			return ind[ind_n(j, n)];
+		}
+
+		// account for the point j on all levels;
+		// the anchors of all levels are known up front, so they are measured in one dist_many
+		template <typename func_t>
+		void add(size_t j, func_t path_dist) {
+			std::array<size_t, 8 * sizeof(size_t)> k, pos;
+			std::array<dist_t, 8 * sizeof(size_t)> d;
+			size_t count = 0;
+			for (size_t n = 1; n <= N; n++) {
+				if (covers(j, n)) {
+					k[count] = ind_k(j, n);
+					pos[count++] = ind_n(j, n);
+				}
+			}
+			dist_many(path_dist, k.data(), count, j, d.data());
+			for (size_t c = 0; c < count; c++) {
+				bound_t &i = ind[pos[c]];
+				i = std::max<bound_t>(i, round_up<bound_t>(d[c]));
+			}
+			P_VAR_STAT(p_var_stats().dist_calls += count);
+		}
 	};
 
-	// to compute the maximizing sequence, we save "point links":
-	// point_links[b] = a  when the interval [a, b] is the last one
-	// in the maximising partition of [0,...,b]
-	std::vector<size_t> point_links(path_size, 0);
+	// the same bounds as dyadic_index, in a layout where the entries of a point are close together:
+	// levels are grouped in tiers of three, levels 3t+1, 3t+2, 3t+3 form tier t,
+	// and the 4 + 2 + 1 entries of a tier t block of 8 << 3t points share one group of 8 slots.
+	// Adding a point or searching over the levels of m touches one group per tier,
+	// i.e. about N/3 cache lines instead of N.
+	template <typename dist_t, typename bound_t = dist_t>
+	struct blocked_dyadic_index {
+		size_t s = 0;
+		size_t N = 1;
+		struct alignas(8 * sizeof(bound_t)) group {
+			bound_t slots[8];
+		};
+		std::vector<group> ind;
+		// for each level n: the first slot of level n in the first group of its tier
+		std::array<size_t, 8 * sizeof(size_t) + 1> level_begin;
 
-	real_t max_p_var = real_t(0);
+		blocked_dyadic_index() = default;
+		explicit blocked_dyadic_index(size_t path_size) {
+			reset(path_size);
+		}
 
-	for (size_t j = 0; j < path_size; j++) {
-		// update ind
-		for (size_t n = 1; n <= N; n++) {
-			if (!(j >> n == s >> n && (s >> (n-1)) % 2 == 0)) {
-				dist_t &i = ind[ind_n(j, n)];
-				i = std::max<dist_t>(i, path_dist(ind_k(j, n), j));
+		void reset(size_t path_size) {
+			s = path_size - 1;
+			N = 1;
+			while (s >> N) {
+				N++;
 			}
+			size_t groups = 0;
+			for (size_t n = 1; n <= N; n++) {
+				size_t l = (n - 1) % 3 + 1;
+				level_begin[n] = groups * 8 + (8 - (8 >> (l - 1)));
+				if (l == 3 || n == N) {
+					groups += (s >> (n - l + 3)) + 1;
+				}
+			}
+			ind.assign(groups, group{});
 		}
-		if (j == 0) {
-			continue;
+
+		size_t ind_k(size_t j, size_t n) const {
+			return std::min<size_t>(((j >> n) << n) + (1 << (n-1)), s);
+		}
+		bool covers(size_t j, size_t n) const {
+			return !(j >> n == s >> n && (s >> (n-1)) % 2 == 0);
+		}
+		// position of the entry as group * 8 + slot,
+		// level 3t+l starts at slot 8 - (8 >> (l-1)) of a group
+		size_t ind_n(size_t j, size_t n) const {
+			size_t jt = j >> ((n - 1) / 3 * 3);
+			size_t l = (n - 1) % 3 + 1;
+			return level_begin[n] + ((jt >> 3) << 3) + ((jt & 7) >> l);
+		}
+		bound_t bound(size_t j, size_t n) const {
+			size_t i = ind_n(j, n);
+			return ind[i / 8].slots[i % 8];
 		}
 
-		// compute max_p_var = p-variation of path[0..j] as
-		//   max{run_p_var[m] + path_dist(m, j)^p}
-		// as m goes through j-1,...,0
+		template <typename func_t>
+		void add(size_t j, func_t path_dist) {
+			std::array<size_t, 8 * sizeof(size_t)> k, pos;
+			std::array<dist_t, 8 * sizeof(size_t)> d;
+			size_t count = 0;
+			for (size_t n = 1; n <= N; n++) {
+				if (covers(j, n)) {
+					k[count] = ind_k(j, n);
+					pos[count++] = ind_n(j, n);
+				}
+			}
+			dist_many(path_dist, k.data(), count, j, d.data());
+			for (size_t c = 0; c < count; c++) {
+				bound_t &i = ind[pos[c] / 8].slots[pos[c] % 8];
+				i = std::max<bound_t>(i, round_up<bound_t>(d[c]));
+			}
+			P_VAR_STAT(p_var_stats().dist_calls += count);
+		}
+	};
+
+	// the index used by p_var_backbone: compile with -DP_VAR_BLOCKED_INDEX for blocked_dyadic_index
+#ifdef P_VAR_BLOCKED_INDEX
+	template <typename dist_t, typename bound_t = dist_t>
+	using backbone_index = blocked_dyadic_index<dist_t, bound_t>;
+#else
+	template <typename dist_t, typename bound_t = dist_t>
+	using backbone_index = dyadic_index<dist_t, bound_t>;
+#endif
+
+	// compute max_p_var = p-variation of path[first..j] as
+	//   max{run_p_var[m] + path_dist(m, j)^p}
+	// as m goes through j-1,...,first, where run_p_var[m] is the p-variation of path[first..m].
+	// On input max_p_var is a lower bound, normally run_p_var[j-1].
+	// The index must account for all points first,...,j, other points do not hurt.
+	// link is set to m where the maximum is attained.
+	// path_dist is only called as path_dist(m, j) with this j, as in dyadic_index::add,
+	// so a caller may load the point j once per step (see p_var_fixed_dim).
+	template <typename real_t, typename power_t, typename run_t, typename index_t, typename func_t>
+	real_t p_var_step(size_t j, power_t p, real_t max_p_var, run_t run_p_var,
+			const index_t & index, func_t path_dist, size_t & link, size_t first = 0)
+	{
+		typedef decltype(path_dist(0, 0)) dist_t;
+
+		size_t N = index.N;
 		size_t m = j - 1;
 		real_t delta = 0;
 		size_t delta_m = j;
+		P_VAR_STAT(size_t iterations = 0);
 		for (size_t n=0;;) {
-			while (n > 0 && m >> n == s >> n && (s >> (n-1)) % 2 == 0) {
+			P_VAR_STAT(iterations++);
+			while (n > 0 && !index.covers(m, n)) {
 				n--;
 			}
 
@@ -162,12 +641,13 @@ auto p_var_backbone(size_t path_size, power_t p, func_t path_dist)
 			// ind[ind_n(m, n)] + path_dist(ind_k(m, n), j) < (max_p_var - run_p_var[m])^(1/p)
 			bool skip = false;
 			if (n > 0) {
-				dist_t id = ind[ind_n(m, n)] + path_dist(ind_k(m, n), j);
+				dist_t id = index.bound(m, n) + path_dist(index.ind_k(m, n), j);
+				P_VAR_STAT(p_var_stats().dist_calls++);
 				if (delta >= id) {
 					skip = true;
 				}
 				else if (m < delta_m) {
-					delta = std::pow(max_p_var - run_p_var[m], 1. / p);
+					delta = internal::root_p(max_p_var - run_p_var[m], p);
 					delta_m = m;
 					if (delta >= id) {
 						skip = true;
@@ -176,8 +656,9 @@ auto p_var_backbone(size_t path_size, power_t p, func_t path_dist)
 			}
 
 			if (skip) {
+				P_VAR_STAT(p_var_stats().skips[n]++);
 				size_t k = (m >> n) << n;
-				if (k > 0) {
+				if (k > first) {
 					m = k - 1;
 					while (n < N && (k>>n) % 2 == 0) {
 						n++;
@@ -193,15 +674,16 @@ auto p_var_backbone(size_t path_size, power_t p, func_t path_dist)
 				}
 				else {
 					dist_t d = path_dist(m, j);
+					P_VAR_STAT(p_var_stats().dist_calls++);
 					if (d >= delta) {
-						real_t new_p_var = run_p_var[m] + std::pow(d, p);
+						real_t new_p_var = run_p_var[m] + internal::pow_p(d, p);
 						if (new_p_var >= max_p_var) {
 							max_p_var = new_p_var;
-							point_links[j] = m;
+							link = m;
 						}
 					}
 
-					if (m > 0) {
+					if (m > first) {
 						while (n < N  &&  (m>>n) % 2 == 0) {
 							n++;
 						}
@@ -214,23 +696,1057 @@ auto p_var_backbone(size_t path_size, power_t p, func_t path_dist)
 			}
 		}
 
-		run_p_var[j] = max_p_var;
+		P_VAR_STAT(p_var_stats().steps++);
+		P_VAR_STAT(p_var_stats().m_iterations += iterations);
+		P_VAR_STAT(p_var_stats().max_m_iterations = std::max(p_var_stats().max_m_iterations, iterations));
+		return max_p_var;
 	}
 
-	ret.value = run_p_var.back();
+	// to compute the maximizing sequence, we save "point links":
+	// point_links[b] = a  when the interval [a, b] is the last one
+	// in the maximising partition of [0,...,b]
+	template <typename links_t>
+	void backtrack_points(const links_t & point_links, size_t s, std::vector<size_t> & points) {
+		points.clear();
+		for (size_t a = s; ; a = point_links[a]) {
+			points.push_back(a);
+			if (a == 0) {
+				break;
+			}
+		}
+		std::reverse(points.begin(), points.end());
+	}
+	template <typename links_t>
+	std::vector<size_t> backtrack_points(const links_t & point_links, size_t s) {
+		std::vector<size_t> points;
+		backtrack_points(point_links, s, points);
+		return points;
+	}
 
-	// points
-	for (size_t a = s; ; a = point_links[a]) {
-		ret.points.push_back(a);
-		if (a == 0) {
-			break;
+	// results for empty and one point paths, returns false if path_size > 1
+	template <typename real_t>
+	bool p_var_trivial(size_t path_size, p_var_ret_t<real_t> & ret) {
+		ret.points.clear();
+		if (path_size == 0) {
+			ret.value = -std::numeric_limits<real_t>::infinity();
+			return true;
+		}
+		else if (path_size == 1) {
+			ret.value = 0;
+			ret.points.push_back(0);
+			return true;
+		}
+		return false;
+	}
+} // namespace internal
+
+// buffers used by p_var_backbone with real_t results and dist_t distances,
+// their memory is kept between calls.
+// The spatial index stores bound_t, e.g. p_var_workspace<double, double, float> halves its memory
+// while distances and p-variation are still computed in double, with the same results.
+template <typename real_t, typename dist_t, typename bound_t>
+struct p_var_workspace {
+	// running p-variation
+	std::vector<real_t> run_p_var;
+	internal::backbone_index<dist_t, bound_t> index;
+	std::vector<size_t> point_links;
+	// the result of the last computation
+	p_var_ret_t<real_t> ret;
+
+	// point_links are needed only for computing the maximising sequence
+	void reset(size_t path_size, bool with_points = true) {
+		run_p_var.assign(path_size, real_t(0));
+		index.reset(path_size);
+		if (with_points) {
+			point_links.assign(path_size, 0);
 		}
 	}
-	std::reverse(ret.points.begin(), ret.points.end());
+};
+
+namespace internal {
+	// fill ws.run_p_var for a path with path_size >= 2 points,
+	// and ws.point_links if with_points is true
+	template <bool with_points, typename func_t, typename power_t, typename workspace_t>
+	void p_var_run(size_t path_size, power_t p, func_t path_dist, workspace_t & ws)
+	{
+		ws.reset(path_size, with_points);
+		auto & run_p_var = ws.run_p_var;
+		auto & index = ws.index;
+		size_t link = 0;
+
+		for (size_t j = 0; j < path_size; j++) {
+			index.add(j, path_dist);
+			if (j == 0) {
+				continue;
+			}
+			run_p_var[j] = internal::p_var_step(j, p, run_p_var[j-1], run_p_var.data(), index, path_dist,
+					with_points ? ws.point_links[j] : link);
+		}
+	}
+} // namespace internal
+
+// same as p_var_backbone, but using the buffers in ws,
+// returns a reference to ws.ret which is valid until the next use of ws
+template <typename func_t, typename power_t, typename workspace_t>
+const auto & p_var_backbone(size_t path_size, power_t p, func_t path_dist, workspace_t & ws)
+{
+	auto & ret = ws.ret;
+	if (internal::p_var_trivial(path_size, ret)) {
+		return ret;
+	}
+
+	internal::p_var_run<true>(path_size, p, path_dist, ws);
+
+	ret.value = ws.run_p_var.back();
+	internal::backtrack_points(ws.point_links, ws.index.s, ret.points);
 
 	return ret;
 }
 
+// same as p_var_backbone, but computes only the value of p-variation:
+// no point links are stored and no maximising sequence is reconstructed
+template <typename func_t, typename power_t>
+auto p_var_value_backbone(size_t path_size, power_t p, func_t path_dist)
+{
+	typedef decltype(path_dist(0, 0)) dist_t;
+	typedef decltype(internal::pow_p(path_dist(0, 0), p)) real_t;
+
+	p_var_workspace<real_t, dist_t> ws;
+	if (internal::p_var_trivial(path_size, ws.ret)) {
+		return ws.ret.value;
+	}
+
+	internal::p_var_run<false>(path_size, p, path_dist, ws);
+	return ws.run_p_var.back();
+}
+
+// p-variation of path[0..j] for all j, written to out[j]:
+// the running p-variation which p_var_value_backbone computes anyway, without a copy
+template <typename func_t, typename power_t, typename real_t>
+void p_var_prefix_backbone(size_t path_size, power_t p, func_t path_dist, real_t * out)
+{
+	typedef decltype(path_dist(0, 0)) dist_t;
+
+	if (path_size == 0) {
+		return;
+	}
+	internal::backbone_index<dist_t> index(path_size);
+	size_t link = 0;
+	out[0] = 0;
+	for (size_t j = 0; j < path_size; j++) {
+		index.add(j, path_dist);
+		if (j > 0) {
+			out[j] = internal::p_var_step(j, p, out[j-1], out, index, path_dist, link);
+		}
+	}
+}
+
+// whether the p-variation is greater than threshold:
+// * true as soon as the running p-variation up to some j is greater, it only grows with j;
+// * false without the search if the upper bound diam^(p-1) * sum_j path_dist(j-1, j)
+//   is not greater, where diam <= 2 max_j path_dist(0, j), since every increment of a partition
+//   is at most diam and the sum of the increments is at most the sum over consecutive points.
+//   The bound only grows with the points it has seen, so its pass stops as soon as it is greater
+//   than threshold: then it cannot help, and for a threshold near the p-variation this is
+//   normally after a short prefix;
+// * otherwise false only after the whole search: the p-variation is not subadditive,
+//   so there is no cheap bound on the rest of the path which would allow stopping earlier.
+template <typename func_t, typename power_t, typename threshold_t>
+bool p_var_exceeds_backbone(size_t path_size, power_t p, threshold_t threshold, func_t path_dist)
+{
+	typedef decltype(path_dist(0, 0)) dist_t;
+	typedef decltype(internal::pow_p(path_dist(0, 0), p)) real_t;
+
+	p_var_workspace<real_t, dist_t> ws;
+	if (internal::p_var_trivial(path_size, ws.ret)) {
+		return ws.ret.value > threshold;
+	}
+
+	// the bound for path[0..j] is factor * length, factor = diam^(p-1) only changes with radius
+	dist_t length = 0;
+	dist_t radius = 0;
+	real_t factor = 0;
+	size_t j = 1;
+	for (; j < path_size && !(factor * length > threshold); j++) {
+		length += path_dist(j - 1, j);
+		dist_t r = path_dist(0, j);
+		if (r > radius) {
+			radius = r;
+			factor = internal::pow_p(2 * radius, p) / (2 * radius);
+		}
+	}
+	if (j == path_size && !(factor * length > threshold)) {
+		return false;
+	}
+
+	ws.reset(path_size, false);
+	auto & run_p_var = ws.run_p_var;
+	size_t link = 0;
+	for (size_t j = 0; j < path_size; j++) {
+		ws.index.add(j, path_dist);
+		if (j > 0) {
+			run_p_var[j] = internal::p_var_step(j, p, run_p_var[j-1], run_p_var.data(), ws.index, path_dist, link);
+			if (run_p_var[j] > threshold) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+template <typename func_t, typename power_t>
+auto p_var_prefix_backbone(size_t path_size, power_t p, func_t path_dist)
+{
+	typedef decltype(internal::pow_p(path_dist(0, 0), p)) real_t;
+
+	std::vector<real_t> prefix(path_size);
+	p_var_prefix_backbone(path_size, p, path_dist, prefix.data());
+	return prefix;
+}
+
+template <typename func_t, typename power_t>
+auto p_var_backbone(size_t path_size, power_t p, func_t path_dist)
+{
+	typedef decltype(path_dist(0, 0)) dist_t;
+	typedef decltype(internal::pow_p(path_dist(0, 0), p)) real_t;
+
+	p_var_workspace<real_t, dist_t> ws;
+	p_var_backbone(path_size, p, path_dist, ws);
+	return std::move(ws.ret);
+}
+
+// *** MULTIPLE EXPONENTS ***
+// Same as p_var_backbone for every p in [p_begin, p_end), returns a vector of results.
+// The spatial index does not depend on p, so it is built only once for the whole path
+// and then shared by all exponents: an index which accounts for the points after j
+// still gives valid upper bounds at step j.
+template <typename func_t, typename power_iterator_t>
+auto p_var_multi_backbone(size_t path_size, power_iterator_t p_begin, power_iterator_t p_end, func_t path_dist)
+{
+	typedef internal::iterator_value_t<power_iterator_t> power_t;
+	typedef decltype(path_dist(0, 0)) dist_t;
+	typedef decltype(internal::pow_p(path_dist(0, 0), std::declval<power_t>())) real_t;
+
+	std::vector<p_var_ret_t<real_t> > rets(std::distance(p_begin, p_end));
+	if (path_size <= 1) {
+		for (auto & ret : rets) {
+			internal::p_var_trivial(path_size, ret);
+		}
+		return rets;
+	}
+
+	internal::backbone_index<dist_t> index(path_size);
+	for (size_t j = 0; j < path_size; j++) {
+		index.add(j, path_dist);
+	}
+
+	std::vector<real_t> run_p_var(path_size, 0);
+	std::vector<size_t> point_links(path_size, 0);
+
+	auto ret = rets.begin();
+	for (auto pit = p_begin; pit != p_end; ++pit, ++ret) {
+		for (size_t j = 1; j < path_size; j++) {
+			run_p_var[j] = internal::p_var_step(j, *pit, run_p_var[j-1], run_p_var.data(), index, path_dist, point_links[j]);
+		}
+		ret->value = run_p_var.back();
+		ret->points = internal::backtrack_points(point_links, index.s);
+	}
+
+	return rets;
+}
+
+// *** PRE-FILTER ***
+// Returns the increasing indices of the points of the path which are kept, always with the first and the last one.
+// A point is removed if
+// * filter.duplicates and it is at distance 0 from the previous kept point:
+//   in any increasing sequence it can be replaced by that point;
+// * filter.collinear and it lies on the segment between the previous kept point and the next point:
+//   then d(u, x)^p + d(x, w)^p is a convex function of x on that segment, because the metric
+//   comes from a norm, so x can be replaced by one of the ends of the segment.
+// Removing points one at a time keeps the p-variation, and when a point is removed,
+// the previous kept point is checked again with its new neighbours.
+// On the real line, collinear removes all points which are not local extrema.
+namespace internal {
+	// b lies on the segment [a, c], with exact comparisons for reals;
+	// for vectors up to rounding in the products (b_i - a_i) * (c_k - a_k)
+	template <typename point_t>
+	bool on_segment(const point_t & a, const point_t & b, const point_t & c, std::true_type) {
+		return (a <= b && b <= c) || (a >= b && b >= c);
+	}
+	template <typename point_t>
+	bool on_segment(const point_t & a, const point_t & b, const point_t & c, std::false_type) {
+		auto ai = std::cbegin(a);
+		auto bi = std::cbegin(b);
+		auto ci = std::cbegin(c);
+		// the coordinate k with the largest |c_k - a_k|
+		auto ak = ai, bk = bi, ck = ci;
+		for (auto a_end = std::cend(a); ai != a_end; ++ai, ++bi, ++ci) {
+			if ((*bi - *ai) * (*ci - *bi) < 0) {
+				return false;
+			}
+			if (std::abs(*ci - *ai) > std::abs(*ck - *ak)) {
+				ak = ai;
+				bk = bi;
+				ck = ci;
+			}
+		}
+		if (*ck == *ak) {
+			return false;
+		}
+		// b - a = t (c - a) with t = (b_k - a_k) / (c_k - a_k)
+		ai = std::cbegin(a);
+		bi = std::cbegin(b);
+		ci = std::cbegin(c);
+		for (auto a_end = std::cend(a); ai != a_end; ++ai, ++bi, ++ci) {
+			if ((*bi - *ai) * (*ck - *ak) != (*ci - *ai) * (*bk - *ak)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	template <typename point_t>
+	bool on_segment(const point_t & a, const point_t & b, const point_t & c) {
+		return on_segment(a, b, c, std::is_arithmetic<point_t>());
+	}
+} // namespace internal
+
+template <typename const_iterator_t, typename func_t>
+std::vector<size_t> p_var_prefilter_points(const_iterator_t path_begin, const_iterator_t path_end, func_t dist, p_var_prefilter filter)
+{
+	size_t path_size = path_end - path_begin;
+	std::vector<size_t> kept;
+	for (size_t j = 0; j < path_size; j++) {
+		const auto & x = *(path_begin + j);
+		bool last = (j + 1 == path_size);
+		if (filter.duplicates && !kept.empty() && !last && dist(*(path_begin + kept.back()), x) == 0) {
+			continue;
+		}
+		if (filter.collinear) {
+			while (kept.size() >= 2
+					&& internal::on_segment(*(path_begin + kept[kept.size() - 2]), *(path_begin + kept.back()), x)) {
+				kept.pop_back();
+			}
+		}
+		kept.push_back(j);
+	}
+	return kept;
+}
+
+// *** DISTANCE CACHE ***
+// Memoises path_dist(a, b) for one path. p_var_backbone measures all distances of the step for b,
+// i.e. of the index update and of the search, as path_dist(a, b) for this b (see p_var_step).
+// A pair is measured again in the same step, e.g. the anchors ind_k(b, n) of the index update
+// in the search, or in the step for a > b when a is such an anchor ahead of b. So there are two layers:
+// * an open addressing table keyed by a for the current b, emptied when b changes;
+// * for a > b, the pair in a slot of level n = bit length of a ^ b at position b mod 2^n:
+//   b is in the first half of the level n dyadic block of a, and the pair is kept until it is
+//   replaced by a pair of a later block, i.e. after the step for a.
+// Each pair is measured at most once as long as the step for one b measures at most
+// capacity / 2 distinct points a; beyond that the distances are measured without storing them.
+// The second layer takes one slot per point on every level, about twice the path size in all.
+// hits() and misses() count the lookups since construction or reset_counters();
+// misses() is the number of evaluations of dist.
+template <typename dist_t>
+class p_var_dist_cache {
+public:
+	// capacity is rounded up to a power of two
+	explicit p_var_dist_cache(size_t capacity = size_t(1) << 16) {
+		size_t size = 2;
+		while (size < capacity) {
+			size *= 2;
+		}
+		entries.resize(size);
+		mask = size - 1;
+		clear();
+	}
+
+	size_t hits() const {
+		return hit_count;
+	}
+	size_t misses() const {
+		return miss_count;
+	}
+	void reset_counters() {
+		hit_count = 0;
+		miss_count = 0;
+	}
+
+	// forget all cached distances, before using the cache for another path
+	void clear() {
+		for (auto & e : entries) {
+			e.b = no_point;
+		}
+		for (auto & level : ahead) {
+			for (auto & e : level) {
+				e.b = no_point;
+			}
+		}
+		current_b = no_point;
+		stored = 0;
+	}
+
+	// path_dist(a, b), computed by eval() if not cached
+	template <typename eval_t>
+	dist_t operator()(size_t a, size_t b, eval_t eval) {
+		if (b != current_b) {
+			current_b = b;
+			stored = 0;
+		}
+		// entries of other points b are free; they are never written while b is current,
+		// so a is stored at the first free entry it probes, and found before any free entry
+		size_t h = a * size_t(0x9E3779B97F4A7C15ull);
+		size_t i = (h ^ (h >> 29)) & mask;
+		for (size_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+			entry & e = entries[i];
+			if (e.b != b) {
+				break;
+			}
+			if (e.a == a) {
+				hit_count++;
+				return e.d;
+			}
+		}
+
+		entry * pair = nullptr;
+		if (a != b) {
+			size_t lo = std::min(a, b);
+			size_t hi = std::max(a, b);
+			size_t n = 0;
+			while ((lo ^ hi) >> n) {
+				n++;
+			}
+			if (ahead.size() < n) {
+				ahead.resize(n);
+			}
+			std::vector<entry> & level = ahead[n - 1];
+			if (level.empty()) {
+				level.resize(size_t(1) << (n - 1), entry{0, no_point, dist_t(0)});
+			}
+			pair = &level[lo & ((size_t(1) << (n - 1)) - 1)];
+			if (pair->a == hi && pair->b == lo) {
+				hit_count++;
+				store(entries[i], a, b, pair->d);
+				return pair->d;
+			}
+		}
+
+		miss_count++;
+		dist_t d = eval();
+		store(entries[i], a, b, d);
+		if (pair != nullptr && a > b) {
+			*pair = entry{a, b, d};
+		}
+		return d;
+	}
+
+private:
+	struct entry {
+		size_t a;
+		size_t b;
+		dist_t d;
+	};
+	static constexpr size_t no_point = std::numeric_limits<size_t>::max();
+
+	// into the first layer, at the free entry e found by the lookup of a
+	void store(entry & e, size_t a, size_t b, dist_t d) {
+		if (e.b != b && 2 * stored < entries.size()) {
+			e = entry{a, b, d};
+			stored++;
+		}
+	}
+
+	std::vector<entry> entries;
+	size_t mask;
+	// ahead[n - 1]: the second layer on level n
+	std::vector<std::vector<entry> > ahead;
+	size_t current_b = no_point;
+	size_t stored = 0;
+	size_t hit_count = 0;
+	size_t miss_count = 0;
+};
+
+// *** STREAMING ***
+// p-variation of a path which grows by one point at a time:
+//   p_var_stream<point_t> pvs(p, dist);
+//   pvs.push(x);
+// Then at any moment:
+//   pvs.value() is the p-variation of the points pushed so far,
+//   pvs.points() is the maximising subsequence in a vector<size_t>,
+//   pvs.size() is the number of points pushed so far.
+// The amortised cost of push is the same as the cost per point of p_var.
+namespace internal {
+	// Same as dyadic_index, but can grow: levels are stored in separate arrays,
+	// and the level n interval [a, a + 2^n) is indexed only once its middle point k = a + 2^(n-1)
+	// has arrived, at which moment ind(k, n) is computed over [a, k].
+	// Before that moment the level n-1 interval [a, k) is used instead, exactly like dyadic_index
+	// does for the last interval.
+	template <typename dist_t>
+	struct growing_dyadic_index {
+		size_t s = 0;
+		size_t N = 1;
+		std::vector<std::vector<dist_t> > ind;
+
+		size_t ind_k(size_t j, size_t n) const {
+			return std::min<size_t>(((j >> n) << n) + (1 << (n-1)), s);
+		}
+		bool covers(size_t j, size_t n) const {
+			return !(j >> n == s >> n && (s >> (n-1)) % 2 == 0);
+		}
+		dist_t bound(size_t j, size_t n) const {
+			return ind[n-1][j >> n];
+		}
+
+		// append the point j, which must be the number of points added before
+		template <typename func_t>
+		void add(size_t j, func_t path_dist) {
+			s = j;
+			while (s >> N) {
+				N++;
+			}
+			if (ind.size() < N) {
+				ind.resize(N);
+			}
+			for (size_t n = 1; n <= N; n++) {
+				std::vector<dist_t> & level = ind[n-1];
+				if (level.size() <= (j >> n)) {
+					level.push_back(0);
+				}
+				if (!covers(j, n)) {
+					continue;
+				}
+				size_t k = ind_k(j, n);
+				dist_t & i = level[j >> n];
+				if (k == j) {
+					for (size_t m = (j >> n) << n; m < j; m++) {
+						i = std::max<dist_t>(i, path_dist(k, m));
+					}
+					P_VAR_STAT(p_var_stats().dist_calls += j - ((j >> n) << n));
+				}
+				else {
+					i = std::max<dist_t>(i, path_dist(k, j));
+					P_VAR_STAT(p_var_stats().dist_calls++);
+				}
+			}
+		}
+	};
+} // namespace internal
+
+template <typename point_t, typename func_t = internal::dist_func_t<point_t>, typename power_t = double>
+class p_var_stream {
+public:
+	typedef decltype(std::declval<func_t>()(std::declval<point_t>(), std::declval<point_t>())) dist_t;
+	typedef decltype(internal::pow_p(std::declval<dist_t>(), std::declval<power_t>())) real_t;
+
+	explicit p_var_stream(power_t p, func_t dist = internal::dist) : p(p), dist(dist) {}
+
+	void push(const point_t & x) {
+		path.push_back(x);
+		size_t j = path.size() - 1;
+		auto path_dist = [this](size_t a, size_t b) {
+			return dist(path[a], path[b]);
+		};
+		index.add(j, path_dist);
+		point_links.push_back(0);
+		run_p_var.push_back(0);
+		if (j > 0) {
+			run_p_var[j] = internal::p_var_step(j, p, run_p_var[j-1], run_p_var.data(), index, path_dist, point_links[j]);
+		}
+	}
+
+	real_t value() const {
+		if (run_p_var.empty()) {
+			return -std::numeric_limits<real_t>::infinity();
+		}
+		return run_p_var.back();
+	}
+
+	std::vector<size_t> points() const {
+		if (path.empty()) {
+			return std::vector<size_t>();
+		}
+		return internal::backtrack_points(point_links, path.size() - 1);
+	}
+
+	size_t size() const {
+		return path.size();
+	}
+
+private:
+	power_t p;
+	func_t dist;
+	std::vector<point_t> path;
+	std::vector<real_t> run_p_var;
+	std::vector<size_t> point_links;
+	internal::growing_dyadic_index<dist_t> index;
+};
+
+// *** SLIDING WINDOW ***
+// p-variation of the last window points of a path which grows by one point at a time:
+//   p_var_window<point_t> pvw(window, p, dist);
+//   pvw.push(x);
+// Then at any moment:
+//   pvw.value() is the p-variation of the last min(window, pvw.size()) points,
+//   pvw.points() is the maximising subsequence, counted from the first point in the window.
+// The reuse of work across overlapping windows is not implemented for general metrics:
+// run_p_var and point_links are prefix values from the first point of the window,
+// so every shift invalidates all of them. value() runs the full search over the window,
+// as p_var on the last window points would, and costs about as much; only the spatial index,
+// updated with each push, and the buffers are kept between calls.
+// For real paths p_var_real::pvar_window does reuse the partition, and is much faster.
+namespace internal {
+	// Same as growing_dyadic_index, but keeps only the intervals relevant for the last
+	// window points, in ring buffers. The level n interval [a, a + 2^n) is used only if
+	// its middle point k = a + 2^(n-1) is in the window, and then ind(k, n) is the maximum
+	// over those points of [a, a + 2^n) which were in the window at the time k arrived or later.
+	template <typename dist_t>
+	struct window_dyadic_index {
+		size_t window;
+		size_t first = 0;
+		size_t s = 0;
+		size_t N = 1;
+		std::vector<std::vector<dist_t> > ind;
+
+		explicit window_dyadic_index(size_t window) : window(window) {}
+
+		size_t ind_k(size_t j, size_t n) const {
+			return ((j >> n) << n) + (size_t(1) << (n-1));
+		}
+		bool covers(size_t j, size_t n) const {
+			size_t k = ind_k(j, n);
+			return k >= first && k <= s;
+		}
+		// at most (window >> n) + 2 intervals of level n have middle points in the window
+		size_t slot(size_t j, size_t n) const {
+			return (j >> n) % ind[n-1].size();
+		}
+		dist_t bound(size_t j, size_t n) const {
+			return ind[n-1][slot(j, n)];
+		}
+
+		// append the point j, which must be the number of points added before
+		template <typename func_t>
+		void add(size_t j, func_t path_dist) {
+			s = j;
+			first = (j >= window) ? j + 1 - window : 0;
+			while (s >> N) {
+				N++;
+			}
+			while (ind.size() < N) {
+				ind.emplace_back((window >> (ind.size() + 1)) + 3, dist_t(0));
+			}
+			for (size_t n = 1; n <= N; n++) {
+				size_t a = (j >> n) << n;
+				dist_t & i = ind[n-1][slot(j, n)];
+				if (a == j) {
+					i = 0;
+				}
+				if (!covers(j, n)) {
+					continue;
+				}
+				size_t k = ind_k(j, n);
+				if (k == j) {
+					for (size_t m = std::max(a, first); m < j; m++) {
+						i = std::max<dist_t>(i, path_dist(k, m));
+					}
+					P_VAR_STAT(p_var_stats().dist_calls += j - std::min(j, std::max(a, first)));
+				}
+				else {
+					i = std::max<dist_t>(i, path_dist(k, j));
+					P_VAR_STAT(p_var_stats().dist_calls++);
+				}
+			}
+		}
+	};
+
+	// running p-variation or point links of a window, indexed by the position in the path
+	template <typename value_t>
+	struct window_array {
+		value_t * data;
+		size_t first;
+		value_t & operator[](size_t m) const {
+			return data[m - first];
+		}
+	};
+} // namespace internal
+
+template <typename point_t, typename func_t = internal::dist_func_t<point_t>, typename power_t = double>
+class p_var_window {
+public:
+	typedef decltype(std::declval<func_t>()(std::declval<point_t>(), std::declval<point_t>())) dist_t;
+	typedef decltype(internal::pow_p(std::declval<dist_t>(), std::declval<power_t>())) real_t;
+
+	p_var_window(size_t window, power_t p, func_t dist = internal::dist)
+		: window(std::max<size_t>(window, 1)), p(p), dist(dist), index(this->window),
+		  run_p_var(this->window, 0), point_links(this->window, 0)
+	{
+		size_t capacity = 1;
+		while (capacity < this->window) {
+			capacity <<= 1;
+		}
+		path.resize(capacity);
+		mask = capacity - 1;
+	}
+
+	void push(const point_t & x) {
+		path[count & mask] = x;
+		index.add(count, [this](size_t a, size_t b) {
+			return dist(path[a & mask], path[b & mask]);
+		});
+		count++;
+		computed = false;
+	}
+
+	real_t value() {
+		compute();
+		if (count == 0) {
+			return -std::numeric_limits<real_t>::infinity();
+		}
+		return run_p_var[size() - 1];
+	}
+
+	std::vector<size_t> points() {
+		compute();
+		if (count == 0) {
+			return std::vector<size_t>();
+		}
+		std::vector<size_t> links(point_links.begin(), point_links.begin() + size());
+		return internal::backtrack_points(links, size() - 1);
+	}
+
+	size_t size() const {
+		return std::min(count, window);
+	}
+
+private:
+	void compute() {
+		if (computed || count == 0) {
+			return;
+		}
+		auto path_dist = [this](size_t a, size_t b) {
+			return dist(path[a & mask], path[b & mask]);
+		};
+		size_t first = index.first;
+		internal::window_array<real_t> run{run_p_var.data(), first};
+		internal::window_array<size_t> links{point_links.data(), first};
+		run[first] = 0;
+		for (size_t j = first + 1; j < count; j++) {
+			run[j] = internal::p_var_step(j, p, run[j-1], run, index, path_dist, links[j], first);
+			links[j] -= first;
+		}
+		computed = true;
+	}
+
+	size_t window;
+	power_t p;
+	func_t dist;
+	internal::window_dyadic_index<dist_t> index;
+	std::vector<real_t> run_p_var;
+	std::vector<size_t> point_links;
+	std::vector<point_t> path;
+	size_t mask;
+	size_t count = 0;
+	bool computed = false;
+};
+
+// *** APPROXIMATION ***
+// Lower and upper bounds of the p-variation, for when a fast estimate is enough:
+//   p_var_approx_options options;
+//   options.tolerance = 0.01;
+//   options.seconds = 0.1;
+//   auto pv = p_var_approx(path, p, dist, options);
+// Then pv.lower <= p_var(path, p, dist).value <= pv.upper, and pv.points is a maximising sequence
+// of pv.lower, i.e. the sum of dist^p along pv.points is pv.lower.
+// The path is split into blocks of K points; with c_i the middle point of block i and r_i the largest
+// distance from c_i in the block,
+// * the sum along any sequence of the c_i, with the end points, is a lower bound;
+// * every increment of a partition of the path either stays in one block, and these add up to at most
+//   the p-variation of the blocks, or goes from a block i to a later block j and is at most
+//   dist(c_i, c_j) + r_i + r_j, so the p-variation of the path (c_i) with this distance,
+//   plus the p-variations of the blocks, is an upper bound.
+// The p-variation of blocks of up to 8 points is computed exactly, of larger ones bounded by diam^(p-1) * length.
+// The lower bound is taken along the maximising sequence of the upper bound.
+// Starting from about approx_blocks blocks, K is halved until pv.upper <= (1 + tolerance) * pv.lower.
+// After each step the time of the exact computation (K = 1, with pv.lower == pv.upper) is estimated
+// from the time of the search over the blocks, and it is done instead of further halving
+// when that is estimated to be faster; no step is started which is expected to end after
+// options.seconds (0 means no limit), then the current bounds are returned.
+// On Brownian paths pv.lower is close to the p-variation much sooner than pv.upper is,
+// see APPROXIMATION BENCHMARK in test.cpp.
+struct p_var_approx_options {
+	double tolerance = 0.01;
+	double seconds = 0;
+	size_t approx_blocks = 4096;
+};
+
+template <typename real_t>
+struct p_var_approx_ret_t {
+	real_t lower;
+	real_t upper;
+	std::vector<size_t> points;
+};
+
+namespace internal {
+	// the bounds for blocks of K >= 2 points, see p_var_approx
+	template <typename real_t, typename func_t, typename power_t>
+	// search_seconds is the time of the search over the blocks, from which the time of
+	// the exact computation is estimated
+	void p_var_block_bounds(size_t path_size, power_t p, func_t path_dist, size_t K,
+			real_t & lower, std::vector<size_t> & points, real_t & upper, double & search_seconds)
+	{
+		typedef decltype(path_dist(0, 0)) dist_t;
+		// the p-variation of blocks up to this size is computed exactly in O(K^2)
+		const size_t exact_block = 8;
+
+		size_t blocks = (path_size + K - 1) / K;
+		std::vector<size_t> centre(blocks);
+		std::vector<dist_t> radius(blocks, dist_t(0));
+		std::vector<real_t> run(exact_block);
+		real_t within = 0;
+		for (size_t i = 0; i < blocks; i++) {
+			size_t a = i * K;
+			size_t b = std::min(a + K, path_size);
+			size_t c = a + (b - a) / 2;
+			centre[i] = c;
+			dist_t length = 0;
+			for (size_t t = a; t < b; t++) {
+				radius[i] = std::max<dist_t>(radius[i], path_dist(c, t));
+				if (t > a) {
+					length += path_dist(t - 1, t);
+				}
+			}
+			if (b - a <= exact_block) {
+				// the p-variation of the block, whose optimal partitions contain a and b - 1
+				for (size_t t = a; t < b; t++) {
+					run[t - a] = 0;
+					for (size_t s = a; s < t; s++) {
+						run[t - a] = std::max<real_t>(run[t - a], run[s - a] + pow_p(path_dist(s, t), p));
+					}
+				}
+				within += run[b - 1 - a];
+			}
+			else if (radius[i] > 0) {
+				within += pow_p(2 * radius[i], p) / (2 * radius[i]) * length;
+			}
+		}
+
+		// the maximising sequence of the centres for the upper bound, with the end points,
+		// gives the lower bound
+		std::chrono::steady_clock::time_point search_start = std::chrono::steady_clock::now();
+		auto pv = p_var_backbone(blocks, p, [&path_dist, &centre, &radius](size_t a, size_t b) {
+			return path_dist(centre[a], centre[b]) + radius[a] + radius[b];
+		});
+		search_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count();
+		upper = pv.value;
+		points.clear();
+		points.push_back(0);
+		for (size_t k : pv.points) {
+			if (centre[k] > points.back()) {
+				points.push_back(centre[k]);
+			}
+		}
+		if (path_size - 1 > points.back()) {
+			points.push_back(path_size - 1);
+		}
+		lower = 0;
+		for (size_t k = 1; k < points.size(); k++) {
+			lower += pow_p(path_dist(points[k - 1], points[k]), p);
+		}
+		upper = std::max<real_t>(upper, 0) + within;
+	}
+} // namespace internal
+
+template <typename func_t, typename power_t>
+auto p_var_approx_backbone(size_t path_size, power_t p, func_t path_dist, const p_var_approx_options & options = p_var_approx_options()) {
+	typedef decltype(internal::pow_p(path_dist(0, 0), p)) real_t;
+	typedef std::chrono::steady_clock steady_clock;
+
+	p_var_approx_ret_t<real_t> ret;
+	// at least one block
+	size_t approx_blocks = std::max<size_t>(options.approx_blocks, 1);
+	size_t K = 1;
+	while (path_size / (2 * K) >= approx_blocks) {
+		K *= 2;
+	}
+	steady_clock::time_point start = steady_clock::now();
+	bool first = true;
+	double last_gap = 0;
+	while (true) {
+		steady_clock::time_point step_start = steady_clock::now();
+		if (K == 1) {
+			auto pv = p_var_backbone(path_size, p, path_dist);
+			ret.lower = ret.upper = pv.value;
+			ret.points = std::move(pv.points);
+			break;
+		}
+		real_t lower, upper;
+		std::vector<size_t> points;
+		double search_seconds;
+		internal::p_var_block_bounds(path_size, p, path_dist, K, lower, points, upper, search_seconds);
+		if (first || lower > ret.lower) {
+			ret.lower = lower;
+			ret.points = std::move(points);
+		}
+		ret.upper = first ? upper : std::min(ret.upper, upper);
+		if (ret.upper <= (1 + options.tolerance) * ret.lower) {
+			break;
+		}
+
+		// Choose the next step by its estimated time:
+		// * a step with K/2 takes about twice as long as this one;
+		// * the exact computation takes about as long per point as the search over the blocks,
+		//   times the ratio of the numbers of levels of their spatial indices;
+		// * the relative gap decreased by the factor gap / last_gap in this step, and if it keeps doing so,
+		//   the tolerance is reached after levels more steps, which take about 2 + 4 + ... + 2^levels
+		//   times as long as this one.
+		// The cheaper of the remaining refinement and the exact computation is taken if it fits into the time
+		// which is left, otherwise the next step if it fits, and otherwise the current bounds are returned.
+		// K = 2 takes about as long as the exact computation, so it is never chosen.
+		steady_clock::time_point now = steady_clock::now();
+		double step_seconds = std::chrono::duration<double>(now - step_start).count();
+		double left_seconds = options.seconds > 0
+			? options.seconds - std::chrono::duration<double>(now - start).count()
+			: std::numeric_limits<double>::infinity();
+		size_t blocks = (path_size + K - 1) / K;
+		double exact_seconds = search_seconds / double(blocks) * double(path_size)
+			* std::log2(double(path_size)) / std::log2(double(std::max<size_t>(blocks, 2)));
+		double next_seconds = 2 * step_seconds;
+		double gap = double(ret.upper) / double(ret.lower) - 1;
+		double refine_seconds = std::numeric_limits<double>::infinity();
+		if (options.tolerance > 0 && K > 4) {
+			// one more step to see how fast the gap decreases
+			refine_seconds = next_seconds;
+			if (!first && gap < last_gap) {
+				double levels = std::ceil(std::log(options.tolerance / gap) / std::log(gap / last_gap));
+				refine_seconds = next_seconds * (std::exp2(std::min(levels, 60.)) - 1);
+			}
+		}
+		first = false;
+		last_gap = gap;
+
+		bool exact = exact_seconds <= refine_seconds;
+		if (exact && exact_seconds <= left_seconds) {
+			K = 1;
+		}
+		else if (K > 4 && next_seconds <= left_seconds) {
+			K /= 2;
+		}
+		else if (!exact && exact_seconds <= left_seconds) {
+			K = 1;
+		}
+		else {
+			break;
+		}
+	}
+	return ret;
+}
+
+template <typename power_t, typename const_iterator_t,
+	 typename func_t = internal::dist_func_t<internal::iterator_value_t<const_iterator_t> > >
+auto p_var_approx(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist = internal::dist,
+		const p_var_approx_options & options = p_var_approx_options()) {
+	internal::iterator_dist<const_iterator_t, func_t> path_dist{path_begin, dist};
+	return p_var_approx_backbone(path_end - path_begin, p, path_dist, options);
+}
+template <typename power_t, typename vector_t, typename func_t = internal::dist_func_t<internal::container_iterator_value_t<vector_t> > >
+auto p_var_approx(const vector_t & path, power_t p, func_t dist = internal::dist,
+		const p_var_approx_options & options = p_var_approx_options()) {
+	return p_var_approx(std::cbegin(path), std::cend(path), p, dist, options);
+}
+
+// *** VIEWS ***
+// Paths which are stored differently, without copying them into a vector of points:
+// * strided_view<T>(data, size, stride): the values data[0], data[stride], ..., data[(size-1)*stride],
+//   e.g. strided_view<double>(matrix + c, rows, cols) is the column c of a row-major matrix;
+// * soa_view<T, D>(columns, size): points std::array<T, D>{columns[0][k], ..., columns[D-1][k]}
+//   for k = 0,...,size-1, i.e. a path stored as D separate arrays of coordinates.
+// They have begin() and end() returning random access iterators, and can be passed to p_var
+// like containers. Points are produced on the fly by value.
+namespace internal {
+	// random access iterator over view[0], view[1], ...
+	template <typename view_t>
+	class view_iterator {
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef typename view_t::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type * pointer;
+		typedef value_type reference;
+
+		view_iterator() = default;
+		view_iterator(const view_t * view, size_t k) : view(view), k(k) {}
+
+		value_type operator*() const { return (*view)[k]; }
+		value_type operator[](difference_type n) const { return (*view)[k + n]; }
+
+		view_iterator & operator++() { ++k; return *this; }
+		view_iterator & operator--() { --k; return *this; }
+		view_iterator operator++(int) { view_iterator it = *this; ++k; return it; }
+		view_iterator operator--(int) { view_iterator it = *this; --k; return it; }
+		view_iterator & operator+=(difference_type n) { k += n; return *this; }
+		view_iterator & operator-=(difference_type n) { k -= n; return *this; }
+		view_iterator operator+(difference_type n) const { return view_iterator(view, k + n); }
+		view_iterator operator-(difference_type n) const { return view_iterator(view, k - n); }
+		friend view_iterator operator+(difference_type n, const view_iterator & it) { return it + n; }
+		difference_type operator-(const view_iterator & it) const { return difference_type(k) - difference_type(it.k); }
+
+		bool operator==(const view_iterator & it) const { return k == it.k; }
+		bool operator!=(const view_iterator & it) const { return k != it.k; }
+		bool operator<(const view_iterator & it) const { return k < it.k; }
+		bool operator>(const view_iterator & it) const { return k > it.k; }
+		bool operator<=(const view_iterator & it) const { return k <= it.k; }
+		bool operator>=(const view_iterator & it) const { return k >= it.k; }
+
+	private:
+		const view_t * view = nullptr;
+		size_t k = 0;
+	};
+} // namespace internal
+
+template <typename T>
+class strided_view {
+public:
+	typedef T value_type;
+	typedef internal::view_iterator<strided_view> const_iterator;
+	typedef const_iterator iterator;
+
+	strided_view(const T * data, size_t size, size_t stride) : data(data), n(size), stride(stride) {}
+
+	T operator[](size_t k) const { return data[k * stride]; }
+	size_t size() const { return n; }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, n); }
+
+private:
+	const T * data;
+	size_t n;
+	size_t stride;
+};
+
+template <typename T, size_t D>
+class soa_view {
+public:
+	typedef std::array<T, D> value_type;
+	typedef internal::view_iterator<soa_view> const_iterator;
+	typedef const_iterator iterator;
+
+	soa_view(const std::array<const T *, D> & columns, size_t size) : columns(columns), n(size) {}
+
+	value_type operator[](size_t k) const {
+		value_type x;
+		for (size_t i = 0; i < D; i++) {
+			x[i] = columns[i][k];
+		}
+		return x;
+	}
+	size_t size() const { return n; }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, n); }
+
+private:
+	std::array<const T *, D> columns;
+	size_t n;
+};
+
 namespace internal {
 	// We define a template function dist(a,b) for computing euclidean distance:
 	// for arithmetic and complex types : std::abs(b - a)
@@ -272,10 +1788,217 @@ namespace internal {
 					));
 	}
 
+	// four lanes of T for the distance kernels: SSE2/AVX or NEON registers where available,
+	// else a plain array which the compiler may vectorise. Four lanes also with AVX-512,
+	// so that all paths add in the order of the plain array and give the same results.
+	template <typename T>
+	struct lanes4 {
+		struct type {
+			T v[4];
+		};
+		static type zero() { return type{{0, 0, 0, 0}}; }
+		static type load(const T * a) { return type{{a[0], a[1], a[2], a[3]}}; }
+		static void store(T * a, type x) { std::copy(x.v, x.v + 4, a); }
+		static type add(type x, type y) { return type{{x.v[0] + y.v[0], x.v[1] + y.v[1], x.v[2] + y.v[2], x.v[3] + y.v[3]}}; }
+		static type sub(type x, type y) { return type{{x.v[0] - y.v[0], x.v[1] - y.v[1], x.v[2] - y.v[2], x.v[3] - y.v[3]}}; }
+		static type mul(type x, type y) { return type{{x.v[0] * y.v[0], x.v[1] * y.v[1], x.v[2] * y.v[2], x.v[3] * y.v[3]}}; }
+		static type abs(type x) { return type{{std::abs(x.v[0]), std::abs(x.v[1]), std::abs(x.v[2]), std::abs(x.v[3])}}; }
+		static type sqrt(type x) { return type{{std::sqrt(x.v[0]), std::sqrt(x.v[1]), std::sqrt(x.v[2]), std::sqrt(x.v[3])}}; }
+	};
+#if defined(__AVX__)
+	template <>
+	struct lanes4<double> {
+		typedef __m256d type;
+		static type zero() { return _mm256_setzero_pd(); }
+		static type load(const double * a) { return _mm256_loadu_pd(a); }
+		static void store(double * a, type x) { _mm256_storeu_pd(a, x); }
+		static type add(type x, type y) { return _mm256_add_pd(x, y); }
+		static type sub(type x, type y) { return _mm256_sub_pd(x, y); }
+		static type mul(type x, type y) { return _mm256_mul_pd(x, y); }
+		static type abs(type x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+		static type sqrt(type x) { return _mm256_sqrt_pd(x); }
+	};
+#endif
+#if defined(__SSE2__)
+	template <>
+	struct lanes4<float> {
+		typedef __m128 type;
+		static type zero() { return _mm_setzero_ps(); }
+		static type load(const float * a) { return _mm_loadu_ps(a); }
+		static void store(float * a, type x) { _mm_storeu_ps(a, x); }
+		static type add(type x, type y) { return _mm_add_ps(x, y); }
+		static type sub(type x, type y) { return _mm_sub_ps(x, y); }
+		static type mul(type x, type y) { return _mm_mul_ps(x, y); }
+		static type abs(type x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x); }
+		static type sqrt(type x) { return _mm_sqrt_ps(x); }
+	};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	template <>
+	struct lanes4<float> {
+		typedef float32x4_t type;
+		static type zero() { return vdupq_n_f32(0); }
+		static type load(const float * a) { return vld1q_f32(a); }
+		static void store(float * a, type x) { vst1q_f32(a, x); }
+		static type add(type x, type y) { return vaddq_f32(x, y); }
+		static type sub(type x, type y) { return vsubq_f32(x, y); }
+		static type mul(type x, type y) { return vmulq_f32(x, y); }
+		static type abs(type x) { return vabsq_f32(x); }
+		static type sqrt(type x) { return vsqrtq_f32(x); }
+	};
+	template <>
+	struct lanes4<double> {
+		struct type {
+			float64x2_t lo, hi;
+		};
+		static type zero() { return type{vdupq_n_f64(0), vdupq_n_f64(0)}; }
+		static type load(const double * a) { return type{vld1q_f64(a), vld1q_f64(a + 2)}; }
+		static void store(double * a, type x) { vst1q_f64(a, x.lo); vst1q_f64(a + 2, x.hi); }
+		static type add(type x, type y) { return type{vaddq_f64(x.lo, y.lo), vaddq_f64(x.hi, y.hi)}; }
+		static type sub(type x, type y) { return type{vsubq_f64(x.lo, y.lo), vsubq_f64(x.hi, y.hi)}; }
+		static type mul(type x, type y) { return type{vmulq_f64(x.lo, y.lo), vmulq_f64(x.hi, y.hi)}; }
+		static type abs(type x) { return type{vabsq_f64(x.lo), vabsq_f64(x.hi)}; }
+		static type sqrt(type x) { return type{vsqrtq_f64(x.lo), vsqrtq_f64(x.hi)}; }
+	};
+#endif
+
+	// kernels for arrays of floating point coordinates: four partial sums in lanes4,
+	// so the additions do not have to wait for each other
+	template <typename T, size_t D>
+	T sq_distance_kernel(const T * a, const T * b) {
+		typedef lanes4<T> L;
+		typename L::type s = L::zero();
+		size_t i = 0;
+		for (; i + 4 <= D; i += 4) {
+			typename L::type d = L::sub(L::load(b + i), L::load(a + i));
+			s = L::add(s, L::mul(d, d));
+		}
+		T t[4];
+		L::store(t, s);
+		T sum = (t[0] + t[1]) + (t[2] + t[3]);
+		for (; i < D; i++) {
+			T d = b[i] - a[i];
+			sum += d * d;
+		}
+		return sum;
+	}
+
+	template <typename T, size_t D>
+	T l1_distance_kernel(const T * a, const T * b) {
+		typedef lanes4<T> L;
+		typename L::type s = L::zero();
+		size_t i = 0;
+		for (; i + 4 <= D; i += 4) {
+			s = L::add(s, L::abs(L::sub(L::load(b + i), L::load(a + i))));
+		}
+		T t[4];
+		L::store(t, s);
+		T sum = (t[0] + t[1]) + (t[2] + t[3]);
+		for (; i < D; i++) {
+			sum += std::abs(b[i] - a[i]);
+		}
+		return sum;
+	}
+
+	// out[i] = sqrt(out[i]) for i < count, four at a time
+	template <typename T>
+	void sqrt_many(T * out, size_t count) {
+		typedef lanes4<T> L;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			L::store(out + i, L::sqrt(L::load(out + i)));
+		}
+		for (; i < count; i++) {
+			out[i] = std::sqrt(out[i]);
+		}
+	}
+
 	// the main function template for dist(a,b)
 	template <class point_t>
 	auto dist(const point_t & a, const point_t & b) { return euclidean_distance(a, b, rank<2>()); }
 
 } // namespace internal
 
+// Distances between points std::array<T, D> with floating point T, to be passed as dist to p_var,
+// computed by the lanes4 kernels (AVX or SSE2, NEON on AArch64, else plain C++):
+// euclidean_dist is the Euclidean distance, l1_dist is sum(|b_i - a_i|).
+// For D >= 4 euclidean_dist adds the squares in another order than the default distance,
+// so the results can differ from it in the last bits. euclidean_dist::many serves the
+// batched index update (see dist_many). In the DISTANCE KERNEL BENCHMARK of test.cpp
+// euclidean_dist takes about half the time of the default distance for D = 64,
+// with less gain for smaller D.
+struct euclidean_dist {
+	template <typename T, size_t D>
+	T operator()(const std::array<T, D> & a, const std::array<T, D> & b) const {
+		return std::sqrt(internal::sq_distance_kernel<T, D>(a.data(), b.data()));
+	}
+	// the distances from the points *a[i] to b, for the update of the spatial index,
+	// with the square roots taken four at a time
+	template <typename T, size_t D>
+	void many(const std::array<T, D> * const * a, size_t count, const std::array<T, D> & b, T * out) const {
+		for (size_t i = 0; i < count; i++) {
+			out[i] = internal::sq_distance_kernel<T, D>(a[i]->data(), b.data());
+		}
+		internal::sqrt_many(out, count);
+	}
+};
+
+struct l1_dist {
+	template <typename T, size_t D>
+	T operator()(const std::array<T, D> & a, const std::array<T, D> & b) const {
+		return internal::l1_distance_kernel<T, D>(a.data(), b.data());
+	}
+};
+
+// *** FIXED DIMENSION ***
+// p_var<D>(path, p, dist) for a path of points std::array<T, D>, e.g. D = 2, 3, 4:
+// returns the same as p_var(path, p, dist), dist defaults to euclidean_dist (not to the default of p_var).
+// For each j the point j is loaded once into a local std::array which the compiler can keep
+// in registers, so that the distances path_dist(m, j) of the index update and of the search
+// only load the contiguous coordinates of m. The compiler mostly does this for p_var already:
+// in the FIXED DIMENSION BENCHMARK of test.cpp both take the same time within noise for D = 2, 3, 4.
+namespace internal {
+	template <size_t D, typename power_t, typename const_iterator_t, typename func_t>
+	auto p_var_fixed_dim(const_iterator_t path_begin, size_t path_size, power_t p, func_t dist)
+	{
+		typedef internal::iterator_value_t<const_iterator_t> point_t;
+		typedef decltype(dist(std::declval<point_t>(), std::declval<point_t>())) dist_t;
+		typedef decltype(internal::pow_p(std::declval<dist_t>(), p)) real_t;
+
+		p_var_workspace<real_t, dist_t> ws;
+		auto & ret = ws.ret;
+		if (p_var_trivial(path_size, ret)) {
+			return std::move(ret);
+		}
+		ws.reset(path_size);
+		auto & run_p_var = ws.run_p_var;
+
+		for (size_t j = 0; j < path_size; j++) {
+			// dyadic_index::add and p_var_step only call path_dist(m, j) for the current j
+			const point_t xj = *(path_begin + j);
+			auto dist_to_j = [&path_begin, &dist, &xj](size_t a, size_t /* always j */) {
+				return dist(*(path_begin + a), xj);
+			};
+			ws.index.add(j, dist_to_j);
+			if (j > 0) {
+				run_p_var[j] = p_var_step(j, p, run_p_var[j-1], run_p_var.data(), ws.index, dist_to_j, ws.point_links[j]);
+			}
+		}
+
+		ret.value = run_p_var.back();
+		backtrack_points(ws.point_links, ws.index.s, ret.points);
+		return std::move(ret);
+	}
+} // namespace internal
+
+template <size_t D, typename power_t, typename const_iterator_t, typename func_t = euclidean_dist>
+auto p_var(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist = func_t()) {
+	typedef internal::iterator_value_t<const_iterator_t> point_t;
+	static_assert(std::tuple_size<point_t>::value == D, "points must have D coordinates");
+	return internal::p_var_fixed_dim<D>(path_begin, size_t(path_end - path_begin), p, dist);
+}
+template <size_t D, typename power_t, typename vector_t, typename func_t = euclidean_dist>
+auto p_var(const vector_t & path, power_t p, func_t dist = func_t()) {
+	return p_var<D>(std::cbegin(path), std::cend(path), p, dist);
+}
+
 } // namespace p_var_ns
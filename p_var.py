@@ -194,7 +194,30 @@ def ex_bm_long():
         pv_time = time.time() - pv_start
         print(f'{n:10d} steps: {p:5.2f}-variation: {pv.value:7.2f}, sequence length: {len(pv.points):5d}, time: {pv_time:7.2f}')
 
+def ex_native():
+    # Example: the native module from p_var_python.cpp (make python) against p_var_backbone
+    try:
+        import numpy
+        import p_var_native
+    except ImportError:
+        print('\nNative module p_var_native not found, skipping')
+        return
+    n = 2500
+    print(f'\nNative module on a poor man\'s Brownian path in R^2 with {n} steps:')
+    path = numpy.cumsum(numpy.random.choice([-1.0, 1.0], size = (n + 1, 2)), axis = 0) / math.sqrt(n)
+    dist = lambda a, b: math.sqrt(pow(path[b][0] - path[a][0], 2) + pow(path[b][1] - path[a][1], 2))
+    dist_0 = lambda a, b: abs(path[b][0] - path[a][0])
+
+    for p in [1.0, math.sqrt(2), 2.0, math.exp(1)]:
+        pv = p_var_native.p_var(path, p)
+        pv_ref = p_var_backbone(len(path), p, dist)
+        pv_err = abs(pv.value - pv_ref.value) + p_var_points_check(pv, p, dist)
+        pv_real = p_var_native.pvar(path[:, 0].copy(), p)
+        pv_real_err = abs(pv_real - p_var_backbone(len(path), p, dist_0).value)
+        print(f'{p:5.2f}-variation: {pv.value:7.2f}, error {pv_err:.2e}, one-dimensional error {pv_real_err:.2e}')
+
 if __name__ == "__main__":
     ex_sq()
     ex_bm()
+    ex_native()
     ex_bm_long()
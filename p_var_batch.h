@@ -0,0 +1,133 @@
+// Copyright 2018 Alexey Korepanov & Terry Lyons
+#pragma once
+
+/*
+ * p_var_batch: p-variation of many independent paths on several threads.
+ *
+ * Usage:
+ *   auto pvs = p_var_batch(paths, p, dist, options)
+ * where paths is a container of paths (e.g. vector<vector<point_t>>),
+ * and p, dist are as in p_var. Then pvs[i] is what p_var(paths[i], p, dist) returns.
+ *
+ * Paths are processed in decreasing order of length, dealt out to per-thread queues;
+ * a thread whose queue is empty steals the longest remaining path from another queue,
+ * so that a long path is not left for the end. Paths are not split between threads.
+ * Each thread reuses one p_var_workspace for all its paths.
+ * Compile with -pthread.
+ */
+
+#include <iterator>
+#include <thread>
+#include <mutex>
+#include <deque>
+
+#include "p_var.h"
+
+namespace p_var_ns {
+
+struct p_var_batch_options {
+	// number of threads, 0 means std::thread::hardware_concurrency()
+	unsigned threads = 0;
+};
+
+namespace internal {
+	// queue of task numbers of one thread, in decreasing order of size:
+	// the owner and thieves both take from the front, i.e. the largest task
+	class task_queue {
+	public:
+		void push(size_t task) {
+			tasks.push_back(task);
+		}
+		bool pop(size_t & task) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (tasks.empty()) {
+				return false;
+			}
+			task = tasks.front();
+			tasks.pop_front();
+			return true;
+		}
+		bool steal(size_t & task) {
+			return pop(task);
+		}
+	private:
+		std::mutex mutex;
+		std::deque<size_t> tasks;
+	};
+
+	// call f(task, thread) for all tasks 0,...,sizes.size()-1,
+	// larger tasks first, balancing the load with work stealing
+	template <typename func_t>
+	void run_work_stealing(const std::vector<size_t> & sizes, unsigned threads, func_t f) {
+		std::vector<size_t> order(sizes.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) {
+			return sizes[a] > sizes[b];
+		});
+
+		threads = std::max<unsigned>(1, std::min<size_t>(threads, sizes.size()));
+		std::vector<task_queue> queues(threads);
+		for (size_t k = 0; k < order.size(); k++) {
+			queues[k % threads].push(order[k]);
+		}
+
+		auto worker = [&](unsigned t) {
+			size_t task;
+			for (;;) {
+				bool found = queues[t].pop(task);
+				for (unsigned v = 1; !found && v < threads; v++) {
+					found = queues[(t + v) % threads].steal(task);
+				}
+				if (!found) {
+					return;
+				}
+				f(task, t);
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (unsigned t = 1; t < threads; t++) {
+			pool.emplace_back(worker, t);
+		}
+		worker(0);
+		for (auto & thread : pool) {
+			thread.join();
+		}
+	}
+} // namespace internal
+
+template <typename power_t, typename paths_t,
+	 typename func_t = internal::dist_func_t<internal::container_iterator_value_t<internal::container_iterator_value_t<paths_t> > > >
+auto p_var_batch(const paths_t & paths, power_t p, func_t dist = internal::dist, p_var_batch_options options = p_var_batch_options())
+{
+	typedef internal::container_iterator_value_t<paths_t> path_t;
+	typedef internal::container_iterator_value_t<path_t> point_t;
+	typedef decltype(dist(std::declval<point_t>(), std::declval<point_t>())) dist_t;
+	typedef decltype(internal::pow_p(std::declval<dist_t>(), p)) real_t;
+
+	std::vector<const path_t *> path_ptrs;
+	std::vector<size_t> sizes;
+	for (const auto & path : paths) {
+		path_ptrs.push_back(&path);
+		sizes.push_back(size_t(std::distance(std::cbegin(path), std::cend(path))));
+	}
+
+	unsigned threads = options.threads;
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	std::vector<p_var_ret_t<real_t> > rets(path_ptrs.size());
+	std::vector<p_var_workspace<real_t, dist_t> > workspaces(threads);
+	internal::run_work_stealing(sizes, threads, [&](size_t task, unsigned thread) {
+		auto path_begin = std::cbegin(*path_ptrs[task]);
+		auto path_dist = [&path_begin,&dist](size_t a, size_t b) {
+			return dist(*(path_begin + a), *(path_begin + b));
+		};
+		rets[task] = p_var_backbone(sizes[task], p, path_dist, workspaces[thread]);
+	});
+
+	return rets;
+}
+
+} // namespace p_var_ns
@@ -0,0 +1,315 @@
+// Copyright 2018 Alexey Korepanov & Terry Lyons
+#pragma once
+
+/*
+ * p_var_file: a versioned binary file of a path, read by memory mapping (see mmap_path.h),
+ * which can also keep what p_var and p_var_real::pvar compute independently of p,
+ * so that later runs with any p start from it instead of from the raw path.
+ *
+ * Usage:
+ *   write_path_file("path.pvp", path);                         // points only
+ *   write_path_file("path.pvp", path, path_file_kind::path, dist); // with the spatial index for dist
+ *   path_file<point_t> file("path.pvp");
+ *   auto pv = p_var(file, p, dist);
+ * returns the same as p_var(path, p, dist), using the stored index if there is one,
+ * which must have been computed with the same dist.
+ * For real sequences, store the reduced form of p_var_real::pvar_extrema:
+ *   write_path_file("x.pvp", p_var_real::pvar_extrema(x), path_file_kind::extrema);
+ *   path_file<double> file("x.pvp");
+ *   double pv = p_var_real::pvar_reduced(file.data(), file.size(), p);   // == pvar(x, p)
+ * point_t is float, double, or std::array of them with a fixed dimension.
+ *
+ * Format, in native byte order:
+ * * a header of 64 bytes: the magic "pvpf", version (uint32 = 1), dtype (uint32: 1 float, 2 double),
+ *   kind (uint32, path_file_kind), dimension (uint64), length (uint64, number of points),
+ *   index_length (uint64, 0 if there is no index), then zeros;
+ * * length * dimension coordinates of dtype, point after point;
+ * * if index_length > 0: starting at the next multiple of 8 bytes, the ind array of dyadic_index
+ *   (see p_var.h) of the whole path, index_length = length - 1 values of dtype, rounded up.
+ * The index depends only on the distances, the extrema only on the values, neither on p.
+ * (The points removed by p_var_real's CheckShortIntervals depend on p, so they are not stored.)
+ * write_path_file throws std::system_error if the file cannot be written,
+ * path_file throws std::system_error if it cannot be mapped and std::runtime_error
+ * if it is not a path file of point_t.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <array>
+#include <vector>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+#include "p_var.h"
+#include "mmap_path.h"
+
+namespace p_var_ns {
+
+// what the points of a path file are
+enum class path_file_kind : uint32_t {
+	// the whole path
+	path = 0,
+	// a real sequence reduced to its end points and local extrema, see p_var_real::pvar_extrema
+	extrema = 1
+};
+
+namespace internal {
+	struct path_file_header {
+		char magic[4];
+		uint32_t version;
+		uint32_t dtype;
+		uint32_t kind;
+		uint64_t dimension;
+		uint64_t length;
+		uint64_t index_length;
+		uint64_t reserved[3];
+	};
+	static_assert(sizeof(path_file_header) == 64, "the header has 64 bytes");
+
+	const uint32_t path_file_version = 1;
+
+	// scalar type and dimension of the points
+	template <typename point_t>
+	struct path_file_point {
+		typedef point_t scalar_t;
+		static constexpr size_t dimension = 1;
+	};
+	template <typename T, size_t D>
+	struct path_file_point<std::array<T, D> > {
+		typedef T scalar_t;
+		static constexpr size_t dimension = D;
+	};
+
+	template <typename scalar_t>
+	constexpr uint32_t path_file_dtype() {
+		static_assert(std::is_same<scalar_t, float>::value || std::is_same<scalar_t, double>::value,
+				"coordinates must be float or double");
+		return std::is_same<scalar_t, float>::value ? 1 : 2;
+	}
+
+	// offset of the index: after the points, rounded up to 8 bytes
+	inline size_t path_file_index_offset(const path_file_header & header, size_t scalar_size) {
+		size_t end = sizeof(path_file_header) + header.length * header.dimension * scalar_size;
+		return (end + 7) / 8 * 8;
+	}
+
+	// read-only storage of dyadic_index in the mapped file
+	template <typename bound_t>
+	struct const_bound_array {
+		const bound_t * data = nullptr;
+		const bound_t & operator[](size_t k) const {
+			return data[k];
+		}
+	};
+
+	// the number of levels N of dyadic_index for path_size points, as in dyadic_index::reset
+	inline size_t dyadic_levels(size_t path_size) {
+		size_t s = path_size - 1;
+		size_t N = 1;
+		while (s >> N) {
+			N++;
+		}
+		return N;
+	}
+
+	// p_var_backbone with an index which already accounts for all points
+	template <typename func_t, typename power_t, typename index_t>
+	auto p_var_indexed_backbone(size_t path_size, power_t p, func_t path_dist, const index_t & index) {
+		typedef decltype(internal::pow_p(path_dist(0, 0), p)) real_t;
+
+		p_var_ret_t<real_t> ret;
+		if (p_var_trivial(path_size, ret)) {
+			return ret;
+		}
+		std::vector<real_t> run_p_var(path_size, real_t(0));
+		std::vector<size_t> point_links(path_size, 0);
+		for (size_t j = 1; j < path_size; j++) {
+			run_p_var[j] = p_var_step(j, p, run_p_var[j-1], run_p_var.data(), index, path_dist, point_links[j]);
+		}
+		ret.value = run_p_var[path_size - 1];
+		backtrack_points(point_links, path_size - 1, ret.points);
+		return ret;
+	}
+
+	template <typename point_t>
+	void write_path_file_data(const std::string & file_name, const point_t * points, size_t length,
+			path_file_kind kind, const typename path_file_point<point_t>::scalar_t * index, size_t index_length)
+	{
+		typedef typename path_file_point<point_t>::scalar_t scalar_t;
+		static_assert(sizeof(point_t) == path_file_point<point_t>::dimension * sizeof(scalar_t),
+				"points must be arrays of coordinates without padding");
+
+		path_file_header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "pvpf", 4);
+		header.version = path_file_version;
+		header.dtype = path_file_dtype<scalar_t>();
+		header.kind = uint32_t(kind);
+		header.dimension = path_file_point<point_t>::dimension;
+		header.length = length;
+		header.index_length = index_length;
+
+		std::FILE * file = std::fopen(file_name.c_str(), "wb");
+		if (file == NULL) {
+			throw std::system_error(errno, std::system_category(), "cannot open " + file_name);
+		}
+		bool failed = std::fwrite(&header, sizeof(header), 1, file) != 1
+			|| std::fwrite(points, sizeof(point_t), length, file) != length;
+		if (index_length > 0) {
+			size_t padding = path_file_index_offset(header, sizeof(scalar_t)) - sizeof(header) - length * sizeof(point_t);
+			const char zeros[8] = {};
+			failed = failed || std::fwrite(zeros, 1, padding, file) != padding
+				|| std::fwrite(index, sizeof(scalar_t), index_length, file) != index_length;
+		}
+		int code = errno;
+		failed = (std::fclose(file) != 0) || failed;
+		if (failed) {
+			throw std::system_error(code, std::system_category(), "cannot write " + file_name);
+		}
+	}
+} // namespace internal
+
+// write the points of a contiguous range, e.g. a vector, to a path file
+template <typename point_t>
+void write_path_file(const std::string & file_name, const point_t * path_begin, const point_t * path_end,
+		path_file_kind kind = path_file_kind::path)
+{
+	internal::write_path_file_data(file_name, path_begin, size_t(path_end - path_begin), kind, nullptr, 0);
+}
+template <typename point_t>
+void write_path_file(const std::string & file_name, const std::vector<point_t> & path,
+		path_file_kind kind = path_file_kind::path)
+{
+	write_path_file(file_name, path.data(), path.data() + path.size(), kind);
+}
+
+// the same with the spatial index of p_var for the distance dist
+template <typename point_t, typename func_t>
+void write_path_file(const std::string & file_name, const point_t * path_begin, const point_t * path_end,
+		path_file_kind kind, func_t dist)
+{
+	typedef typename internal::path_file_point<point_t>::scalar_t scalar_t;
+	auto path_dist = [&path_begin,&dist](size_t a, size_t b) {
+		return dist(*(path_begin + a), *(path_begin + b));
+	};
+	typedef decltype(path_dist(0, 0)) dist_t;
+
+	size_t length = size_t(path_end - path_begin);
+	internal::dyadic_index<dist_t, scalar_t> index;
+	if (length > 1) {
+		index.reset(length);
+		for (size_t j = 0; j < length; j++) {
+			index.add(j, path_dist);
+		}
+	}
+	internal::write_path_file_data(file_name, path_begin, length, kind, index.ind.data(), index.ind.size());
+}
+template <typename point_t, typename func_t>
+void write_path_file(const std::string & file_name, const std::vector<point_t> & path,
+		path_file_kind kind, func_t dist)
+{
+	write_path_file(file_name, path.data(), path.data() + path.size(), kind, dist);
+}
+
+// a memory mapped path file of points point_t
+template <typename point_t>
+class path_file {
+	typedef typename internal::path_file_point<point_t>::scalar_t scalar_t;
+
+public:
+	explicit path_file(const std::string & file_name) : file(file_name) {
+		if (file.size() < sizeof(header)) {
+			throw std::runtime_error(file_name + " is not a path file");
+		}
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, "pvpf", 4) != 0) {
+			throw std::runtime_error(file_name + " is not a path file");
+		}
+		if (header.version != internal::path_file_version) {
+			throw std::runtime_error(file_name + " has an unsupported version of the path file format");
+		}
+		if (header.dtype != internal::path_file_dtype<scalar_t>()
+				|| header.dimension != internal::path_file_point<point_t>::dimension) {
+			throw std::runtime_error(file_name + " has points of another type");
+		}
+		// compare the counts before multiplying, so that a corrupted header cannot overflow the sizes
+		if (header.length > (file.size() - sizeof(header)) / sizeof(point_t)) {
+			throw std::runtime_error(file_name + " is truncated");
+		}
+		if (header.index_length > 0) {
+			if (header.index_length + 1 != header.length) {
+				throw std::runtime_error(file_name + " has an index of the wrong length");
+			}
+			size_t offset = internal::path_file_index_offset(header, sizeof(scalar_t));
+			if (offset > file.size() || header.index_length > (file.size() - offset) / sizeof(scalar_t)) {
+				throw std::runtime_error(file_name + " is truncated");
+			}
+		}
+	}
+
+	path_file_kind kind() const {
+		return path_file_kind(header.kind);
+	}
+
+	size_t size() const {
+		return header.length;
+	}
+	const point_t * data() const {
+		return reinterpret_cast<const point_t *>(file.data() + sizeof(header));
+	}
+	const point_t * begin() const {
+		return data();
+	}
+	const point_t * end() const {
+		return data() + size();
+	}
+	const point_t & operator[](size_t k) const {
+		return data()[k];
+	}
+
+	// the stored ind array of dyadic_index, with index_size() = size() - 1 values, or none
+	bool has_index() const {
+		return header.index_length > 0;
+	}
+	const scalar_t * index_data() const {
+		return reinterpret_cast<const scalar_t *>(file.data() + internal::path_file_index_offset(header, sizeof(scalar_t)));
+	}
+	size_t index_size() const {
+		return header.index_length;
+	}
+
+	// drop the mapped pages from the memory of the process, see mmap_path
+	void release() const {
+		file.release();
+	}
+
+private:
+	mmap_path<unsigned char> file;
+	internal::path_file_header header;
+};
+
+// p-variation of the path in a path file, the same as p_var(file.begin(), file.end(), p, dist);
+// the stored index is used if there is one, it must have been computed with the same dist
+// (the default dist of p_var if dist is omitted)
+template <typename power_t, typename point_t, typename func_t = internal::dist_func_t<point_t> >
+auto p_var(const path_file<point_t> & path, power_t p, func_t dist = internal::dist) {
+	auto path_dist = [&path,&dist](size_t a, size_t b) {
+		return dist(path[a], path[b]);
+	};
+	if (!path.has_index()) {
+		return p_var_backbone(path.size(), p, path_dist);
+	}
+	typedef decltype(path_dist(0, 0)) dist_t;
+	typedef typename internal::path_file_point<point_t>::scalar_t scalar_t;
+	internal::dyadic_index<dist_t, scalar_t, internal::const_bound_array<scalar_t> > index;
+	index.s = path.size() - 1;
+	index.N = internal::dyadic_levels(path.size());
+	index.ind.data = path.index_data();
+	return internal::p_var_indexed_backbone(path.size(), p, path_dist, index);
+}
+
+} // namespace p_var_ns
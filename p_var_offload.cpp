@@ -0,0 +1,152 @@
+// p-variation of batches of real sequences with OpenMP target offloading
+
+#include <cmath>
+#include <algorithm>
+#include <new>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "p_var_offload.h"
+
+namespace p_var_real {
+#pragma omp declare target
+	// the same bits as pvar_diff in p_var_real.cpp, which chooses the power once per call instead
+	static double OffloadPvarDiff(double diff, double p){
+		double d = std::fabs(diff);
+		if (p == 2) {
+			return d * d;
+		}
+		if (p == 3) {
+			return d * d * d;
+		}
+		if (p == 4) {
+			double d2 = d * d;
+			return d2 * d2;
+		}
+		if (p == 2.5) {
+			return d * d * std::sqrt(d);
+		}
+		return std::pow(d, p);
+	}
+
+	// p-variation of x[0..n-1], computed as the last value of PrefixPvar in p_var_real.cpp,
+	// on the fly for the local extrema of x only.
+	// The stack of partition points is kept as their values stack_x and the p-variations stack_pv
+	// up to them; lo and hi hold the dyadic blocks of stack positions, level l at level_begin[l].
+	// All four buffers have n values.
+	static double OffloadPvar(const double* x, size_t n, double p,
+			double* stack_x, double* stack_pv, double* lo, double* hi){
+		if (n <= 1) {
+			return 0;
+		}
+		size_t level_begin[8 * sizeof(size_t) + 1];
+		level_begin[1] = 0;
+		for (size_t l = 1; l < 8 * sizeof(size_t); l++) {
+			level_begin[l + 1] = level_begin[l] + (n >> l);
+		}
+
+		stack_x[0] = x[0];
+		stack_pv[0] = 0;
+		size_t size = 1;
+		double last = x[0];
+		for (size_t j = 1; j < n; j++) {
+			double xj = x[j];
+			// points between the last kept point and the next one do not change the p-variation
+			if (j + 1 < n && (xj - last) * (x[j+1] - xj) >= 0) {
+				continue;
+			}
+			last = xj;
+
+			size_t e = size - 1;
+			size_t best = e;
+			double max_pv = stack_pv[e] + OffloadPvarDiff(xj - stack_x[e], p);
+			while (e > 0) {
+				size_t l = 0;
+				while (((e >> l) & 1) == 0) {
+					l++;
+				}
+				for (; l > 0; l--) {
+					size_t b = level_begin[l] + (e >> l) - 1;
+					double join = std::max(xj - lo[b], hi[b] - xj);
+					if (stack_pv[e - 1] + OffloadPvarDiff(join, p) <= max_pv) {
+						break;
+					}
+				}
+				if (l == 0) {
+					double pv = stack_pv[e - 1] + OffloadPvarDiff(xj - stack_x[e - 1], p);
+					if (pv > max_pv) {
+						max_pv = pv;
+						best = e - 1;
+					}
+					e--;
+				} else {
+					e -= size_t(1) << l;
+				}
+			}
+
+			size = best + 1;
+			stack_x[size] = xj;
+			stack_pv[size] = max_pv;
+			size++;
+			for (size_t l = 1; size % (size_t(2) << (l - 1)) == 0; l++) {
+				size_t b = level_begin[l] + (size >> l) - 1;
+				if (l == 1) {
+					lo[b] = std::min(stack_x[size - 2], stack_x[size - 1]);
+					hi[b] = std::max(stack_x[size - 2], stack_x[size - 1]);
+				} else {
+					size_t c = level_begin[l - 1] + 2 * ((size >> l) - 1);
+					lo[b] = std::min(lo[c], lo[c + 1]);
+					hi[b] = std::max(hi[c], hi[c + 1]);
+				}
+			}
+		}
+		return stack_pv[size - 1];
+	}
+#pragma omp end declare target
+
+	std::vector<double> pvar_batch_offload(const std::vector<double>& values, const std::vector<size_t>& offsets, double p) {
+		size_t count = offsets.empty() ? 0 : offsets.size() - 1;
+		std::vector<double> pvs(count);
+		if (count == 0) {
+			return pvs;
+		}
+		size_t total = values.size();
+		const double* v = values.data();
+		const size_t* o = offsets.data();
+		double* out = pvs.data();
+		// scratch buffers: stack_x, stack_pv, lo and hi of every sequence,
+		// allocated on the device, and in host memory only when the kernel runs on the host
+		bool on_device = false;
+		double* scratch = nullptr;
+#ifdef _OPENMP
+		int device = omp_get_default_device();
+		on_device = omp_get_num_devices() > 0;
+		if (on_device) {
+			scratch = static_cast<double*>(omp_target_alloc(4 * total * sizeof(double), device));
+			if (scratch == nullptr) {
+				throw std::bad_alloc();
+			}
+		}
+#endif
+		std::vector<double> host_scratch;
+		if (!on_device) {
+			host_scratch.resize(4 * total);
+			scratch = host_scratch.data();
+		}
+
+#pragma omp target teams distribute parallel for if(target: on_device) device(device) is_device_ptr(scratch) map(to: v[0:total], o[0:count+1]) map(from: out[0:count])
+		for (size_t i = 0; i < count; i++) {
+			size_t b = o[i];
+			out[i] = OffloadPvar(v + b, o[i+1] - b, p,
+					scratch + b, scratch + total + b, scratch + 2 * total + b, scratch + 3 * total + b);
+		}
+
+#ifdef _OPENMP
+		if (on_device) {
+			omp_target_free(scratch, device);
+		}
+#endif
+		return pvs;
+	}
+}
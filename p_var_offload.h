@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+ * p_var_offload: p-variation of a batch of many short real sequences on an accelerator,
+ * with OpenMP target offloading (make offload, see README).
+ *
+ * Usage:
+ *   std::vector<double> pvs = p_var_real::pvar_batch_offload(values, offsets, p);
+ * Then pvs[i] is p_var_real::pvar of values[offsets[i]], ..., values[offsets[i+1] - 1],
+ * the same as p_var_real::pvar_batch(values, offsets, p), which is the reference in offload-test.cpp.
+ *
+ * Each sequence is processed by one device thread, in scratch buffers of 4 doubles per value
+ * which are allocated on the device once for the whole batch, so the kernel does not allocate memory.
+ * Without a device, or compiled without -fopenmp, the kernel runs on the host,
+ * and only then are the buffers allocated in host memory.
+ */
+
+#include <vector>
+#include <cstddef>
+
+namespace p_var_real {
+	std::vector<double> pvar_batch_offload(const std::vector<double>& values, const std::vector<size_t>& offsets, double p);
+}
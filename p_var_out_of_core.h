@@ -0,0 +1,122 @@
+// Copyright 2018 Alexey Korepanov & Terry Lyons
+#pragma once
+
+/*
+ * p_var_out_of_core: p-variation of paths which together with the working memory
+ * of p_var do not fit into RAM.
+ *
+ * Usage:
+ *   mmap_path<point_t> path("path.bin");
+ *   p_var_out_of_core_options options;
+ *   options.scratch_dir = "/var/tmp";
+ *   options.max_resident = size_t(1) << 30;
+ *   auto pv = p_var_out_of_core(path, p, dist, options);
+ * returns the same as p_var(path.begin(), path.end(), p, dist).
+ *
+ * The running p-variation, the point links and the spatial index are kept in
+ * memory mapped temporary files in options.scratch_dir (see scratch_array in mmap_path.h),
+ * about 8 + 8 + sizeof(dist_t) bytes per point.
+ * When the resident memory of the process exceeds options.max_resident bytes,
+ * the mapped pages of the scratch files and of the path are dropped and later read back
+ * from the files as needed, so that the resident memory stays around max_resident.
+ * Resident memory is measured on Linux; elsewhere the pages are dropped
+ * every options.check_every points.
+ * Throws std::system_error if the scratch files cannot be created.
+ */
+
+#include <string>
+#include <fstream>
+
+#include "p_var.h"
+#include "mmap_path.h"
+
+namespace p_var_ns {
+
+struct p_var_out_of_core_options {
+	// directory for the temporary files
+	std::string scratch_dir = "/tmp";
+	// resident memory in bytes above which mapped pages are dropped
+	size_t max_resident = size_t(1) << 30;
+	// the resident memory is checked after every check_every points
+	size_t check_every = size_t(1) << 14;
+};
+
+namespace internal {
+	// resident memory of the process in bytes, or 0 if unknown
+	inline size_t resident_bytes() {
+#ifdef __linux__
+		std::ifstream statm("/proc/self/statm");
+		size_t pages = 0, resident = 0;
+		if (statm >> pages >> resident) {
+			return resident * size_t(sysconf(_SC_PAGESIZE));
+		}
+#endif
+		return 0;
+	}
+
+	template <typename real_t, typename func_t, typename power_t, typename release_t>
+	p_var_ret_t<real_t> p_var_out_of_core_run(size_t path_size, power_t p, func_t path_dist,
+			const p_var_out_of_core_options & options, release_t release_path)
+	{
+		typedef decltype(path_dist(0, 0)) dist_t;
+
+		p_var_ret_t<real_t> ret;
+		if (p_var_trivial(path_size, ret)) {
+			return ret;
+		}
+
+		scratch_array<real_t> run_p_var(options.scratch_dir);
+		scratch_array<size_t> point_links(options.scratch_dir);
+		run_p_var.assign(path_size, real_t(0));
+		point_links.assign(path_size, 0);
+		dyadic_index<dist_t, dist_t, scratch_array<dist_t> > index(path_size, options.scratch_dir);
+
+		for (size_t j = 0; j < path_size; j++) {
+			index.add(j, path_dist);
+			if (j > 0) {
+				run_p_var[j] = p_var_step(j, p, run_p_var[j-1], run_p_var.data(), index, path_dist, point_links[j]);
+			}
+			if ((j + 1) % options.check_every == 0) {
+				size_t resident = resident_bytes();
+				if (resident == 0 || resident > options.max_resident) {
+					run_p_var.release();
+					point_links.release();
+					index.ind.release();
+					release_path();
+				}
+			}
+		}
+
+		ret.value = run_p_var[path_size - 1];
+		backtrack_points(point_links, index.s, ret.points);
+		return ret;
+	}
+} // namespace internal
+
+// path given by random access iterators, e.g. into a vector which fits into memory
+template <typename power_t, typename const_iterator_t, typename func_t>
+auto p_var_out_of_core(const_iterator_t path_begin, const_iterator_t path_end, power_t p, func_t dist,
+		const p_var_out_of_core_options & options = p_var_out_of_core_options())
+{
+	auto path_dist = [&path_begin,&dist](size_t a, size_t b) {
+		return dist(*(path_begin + a), *(path_begin + b));
+	};
+	typedef decltype(internal::pow_p(path_dist(0, 0), p)) real_t;
+	return internal::p_var_out_of_core_run<real_t>(path_end - path_begin, p, path_dist, options, []() {});
+}
+
+// memory mapped path, whose pages are dropped together with the scratch files
+template <typename power_t, typename point_t, typename func_t>
+auto p_var_out_of_core(const mmap_path<point_t> & path, power_t p, func_t dist,
+		const p_var_out_of_core_options & options = p_var_out_of_core_options())
+{
+	auto path_dist = [&path,&dist](size_t a, size_t b) {
+		return dist(path[a], path[b]);
+	};
+	typedef decltype(internal::pow_p(path_dist(0, 0), p)) real_t;
+	return internal::p_var_out_of_core_run<real_t>(path.size(), p, path_dist, options, [&path]() {
+		path.release();
+	});
+}
+
+} // namespace p_var_ns
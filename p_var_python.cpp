@@ -0,0 +1,73 @@
+// Python module p_var_native with the C++ methods for NumPy arrays of float64 (make python, see README):
+//   import numpy as np, p_var_native
+//   pv = p_var_native.p_var(path, p)  # path of shape (N,) or (N, d), Euclidean distance
+//   pv.value, pv.points               # as p_var_backbone in p_var.py, which is the reference
+//   v = p_var_native.pvar(x, p)       # p_var_real::pvar of x of shape (N,)
+// The arrays are read in place: p_var takes any strides, pvar takes C contiguous arrays,
+// other arrays and data types are converted to a temporary copy first.
+// The GIL is released during the computation, so calls from several Python threads run in parallel.
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include "p_var.h"
+#include "p_var_real.h"
+
+namespace py = pybind11;
+
+namespace {
+	typedef p_var_ns::p_var_ret_t<double> p_var_ret;
+
+	p_var_ret p_var(py::array_t<double, py::array::forcecast> path, double p) {
+		if (path.ndim() == 1) {
+			auto x = path.unchecked<1>();
+			py::gil_scoped_release release;
+			return p_var_ns::p_var_backbone(size_t(x.shape(0)), p, [&x](size_t a, size_t b) {
+				return std::abs(x(py::ssize_t(b)) - x(py::ssize_t(a)));
+			});
+		}
+		if (path.ndim() == 2) {
+			auto x = path.unchecked<2>();
+			py::ssize_t d = x.shape(1);
+			py::gil_scoped_release release;
+			return p_var_ns::p_var_backbone(size_t(x.shape(0)), p, [&x, d](size_t a, size_t b) {
+				double s = 0;
+				for (py::ssize_t i = 0; i < d; i++) {
+					double t = x(py::ssize_t(b), i) - x(py::ssize_t(a), i);
+					s += t * t;
+				}
+				return std::sqrt(s);
+			});
+		}
+		throw std::invalid_argument("path must be of shape (N,) or (N, d)");
+	}
+
+	double pvar(py::array_t<double, py::array::c_style | py::array::forcecast> x, double p) {
+		if (x.ndim() != 1) {
+			throw std::invalid_argument("x must be of shape (N,)");
+		}
+		const double* data = x.data();
+		size_t n = size_t(x.shape(0));
+		py::gil_scoped_release release;
+		return p_var_real::pvar(data, n, p);
+	}
+}
+
+PYBIND11_MODULE(p_var_native, m) {
+	m.doc() = "p-variation of paths given by NumPy arrays, see p_var.h and p_var_real.h";
+
+	py::class_<p_var_ret>(m, "p_var_ret")
+		.def_readonly("value", &p_var_ret::value)
+		.def_readonly("points", &p_var_ret::points);
+
+	m.def("p_var", &p_var, py::arg("path"), py::arg("p"),
+			"p-variation of a path of shape (N,) or (N, d) with the Euclidean distance, "
+			"with .value and the maximising sequence of indices .points");
+	m.def("pvar", &pvar, py::arg("x"), py::arg("p"),
+			"p-variation of a real sequence x of shape (N,) by the one-dimensional method");
+}
@@ -4,46 +4,113 @@
 // Pavel Zorin-Kranich <pzorin@uni-bonn.de>
 
 #include <cmath>
-#include <list>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <cstdio>
+#include <cerrno>
+#include <system_error>
+#include <stdexcept>
+#include <istream>
+#include <ostream>
 
 #include "p_var_real.h"
-#include <bits/stdint-uintn.h>
+
+#ifdef P_VAR_STATS
+#define P_VAR_REAL_STAT(statement) statement
+#else
+#define P_VAR_REAL_STAT(statement)
+#endif
 
 namespace p_var_real {
-	// -------------------------------- definitions of types  ---------------------------------- //
-	struct pointdata {
-		uint32_t prev, next; // emulate double-linked list
-		double pvdiff; // Difference to previous
-	};
-	
-	typedef std::vector<pointdata> DoublyLinkedList;    // list of admissible points, in form of forward and backward links
+	using detail::basic_pointdata;
+	using detail::basic_DoublyLinkedList;
+	using detail::basic_pvtemppoint;
+	using detail::basic_MergeBuffers;
 	
-	struct pvtemppoint{
-		uint32_t it;
-		double ev;
+#ifdef P_VAR_STATS
+	pvar_stats_t & pvar_stats() {
+		static thread_local pvar_stats_t stats;
+		return stats;
+	}
+#endif
+
+	// d^p for d >= 0: pvar_power<num, den> for p = num/den known at compile time, computed by
+	// multiplications and sqrt, and pvar_power_real for any other p, computed by std::pow.
+	// <3>, <4> and <5, 2> round two or three times, see pvar in p_var_real.h.
+	template <int num, int den = 1>
+	struct pvar_power;
+	template <>
+	struct pvar_power<1> {
+		double operator()(double d) const { return d; }
+	};
+	template <>
+	struct pvar_power<2> {
+		double operator()(double d) const { return d * d; }
+	};
+	template <>
+	struct pvar_power<3> {
+		double operator()(double d) const { return d * d * d; }
+	};
+	template <>
+	struct pvar_power<4> {
+		double operator()(double d) const { d *= d; return d * d; }
+	};
+	template <>
+	struct pvar_power<5, 2> {
+		double operator()(double d) const { return d * d * std::sqrt(d); }
+	};
+	struct pvar_power_real {
+		double p;
+		double operator()(double d) const { return std::pow(d, p); }
 	};
 	
+	// f(power) for the power type of p, so that the exponent is chosen once per call of a public function
+	// and not at each pvar_diff
+	template <typename func_t>
+	auto WithPower(double p, func_t f) -> decltype(f(pvar_power_real{p})) {
+		if (p == 1) {
+			return f(pvar_power<1>());
+		}
+		if (p == 2) {
+			return f(pvar_power<2>());
+		}
+		if (p == 3) {
+			return f(pvar_power<3>());
+		}
+		if (p == 4) {
+			return f(pvar_power<4>());
+		}
+		if (p == 2.5) {
+			return f(pvar_power<5, 2>());
+		}
+		return f(pvar_power_real{p});
+	}
 	
-	// the difference used in p-variation, i.e. the abs power of diff.
-	double pvar_diff(double diff, double p){
-		return std::pow(std::abs(diff), p);
+	// the difference used in p-variation, i.e. the abs power of diff
+	template <typename power_t>
+	double pvar_diff(double diff, const power_t& p){
+		return p(std::abs(diff));
 	}
 	
 	// find local extrema and put them in a doubly linked list
-	void DetectLocalExtrema(const NumericVector& x, DoublyLinkedList & links, const double p){
-		uint32_t last_extremum = 0;
+	template <typename index_t, typename power_t>
+	void DetectLocalExtrema(const double* x, index_t n, basic_DoublyLinkedList<index_t> & links, const power_t& p){
+		index_t last_extremum = 0;
 		int direction = 0;
 		bool new_extremum = false;
-		uint32_t n = x.size();
 		double cur_value = x[0];
 		double last_value = cur_value;
-		double next_value;
-		pointdata last_link;
+		double next_value = cur_value;
+		basic_pointdata<index_t> last_link;
 		last_link.prev = 0;
 		last_link.pvdiff = 0.0;
+		P_VAR_REAL_STAT(pvar_stats().extrema++);
 		
-		for(uint32_t i = 0 ; i<n ; i++) {
-			uint32_t j = i+1;
+		for(index_t i = 0 ; i<n ; i++) {
+			index_t j = i+1;
 			if (j != n) {
 				next_value = x[j];
 				if (next_value>cur_value){
@@ -60,6 +127,7 @@ namespace p_var_real {
 				new_extremum = true;
 			}
 			if (new_extremum) {
+				P_VAR_REAL_STAT(pvar_stats().extrema++);
 				last_link.next = i;
 				links[last_extremum] = last_link;
 				last_link.prev = last_extremum;
@@ -70,11 +138,12 @@ namespace p_var_real {
 			cur_value = next_value;
 		}
 		last_link.next = n;
-		links.back() = last_link;
+		links[n-1] = last_link;
 	}
 	
 	// Make sure that all intervals of length 3 are optimal
-	void CheckShortIntervals(const NumericVector& x, DoublyLinkedList & links, const double& p){
+	template <typename index_t, typename power_t>
+	void CheckShortIntervals(const double* x, index_t n, basic_DoublyLinkedList<index_t> & links, const power_t& p){
 		// Main principle:
 		// if |pt[i] - pt[i+ d]|^p > sum_{j={i+1}}^d   |pt[j] - pt[j-1]|^p
 		// but all shorter intervals are optimal,
@@ -83,9 +152,8 @@ namespace p_var_real {
 		double csum = 0;
 		double fjoinval;
 		
-		uint32_t int_begin, int_end;
+		index_t int_begin, int_end;
 		int_begin = int_end = 0;
-		uint32_t n = x.size();
 		for (uint32_t dcount = 0; dcount<3; dcount++) {
 			int_end = links[int_end].next;
 			if (int_end == n) {
@@ -105,6 +173,7 @@ namespace p_var_real {
 				csum -= links[int_begin].pvdiff;
 				csum += links[int_end].pvdiff;
 			} else { // mid points are redundant, erase them
+				P_VAR_REAL_STAT(pvar_stats().short_removed += 2);
 				links[int_begin].next = int_end;
 				links[int_end].prev = int_begin;
 				links[int_end].pvdiff = fjoinval;
@@ -126,87 +195,100 @@ namespace p_var_real {
 		}
 	}
 	
-	// Merge optimal intervals. LSI is the length of optimal intervals in the beginning.
-	void MergeIntervalsRecursively(const NumericVector& x, DoublyLinkedList & links, const double& p, const uint32_t LSI=2){
+	// merge two intervals ([a, v] and [v, b]) which are known to be good.
+	// Only links of points in [a, b] are read, and only links[a].next and the links of (a, b] are written,
+	// so disjoint pairs of intervals can be merged concurrently.
+	// Returns the increase of the sum of pvdiff over [a, b].
+	template <typename index_t, typename power_t>
+	double Merge2GoodInt(const double* x, basic_DoublyLinkedList<index_t> & links, const power_t& p, basic_MergeBuffers<index_t> & tmp, index_t a, index_t v, index_t b){
+		std::vector<basic_pvtemppoint<index_t> > & av_mins = tmp.av_mins;
+		std::vector<basic_pvtemppoint<index_t> > & av_maxs = tmp.av_maxs;
+		std::vector<basic_pvtemppoint<index_t> > & vb_mins = tmp.vb_mins;
+		std::vector<basic_pvtemppoint<index_t> > & vb_maxs = tmp.vb_maxs;
 		
 		// Main principle:
-		// 1. Put endpoints of optimal intervals in IterList
-		// 2. Merge pairs of adjacent intervals using the function Merge2GoodInt. Repeat until all intervals are merged.
+		// 1. Find potential points in intervals [a,v) and (v, b]
+		//    (i.e. the points that could make a new f-joint with any point form opposite interval).
+		//    Those points are find using cummin and cummac starting from v.
+		//     Some points might be dropped out before actual checking, but experiment showed, that it is not worthwhile.
+		// 2. Sequentially check all possible joints. If any increase is detected, then all middle points are insignificant.
 		
-		// temporary data used by Merge2GoodInt. Declaring it here avoids allocating/deallocating it at each call of Merge2GoodInt.
-		std::vector<pvtemppoint> av_mins, av_maxs, vb_mins, vb_maxs;
+		if (a==v || v==b) return 0; // nothing to calculate, exit the procedure.
 		
-		// merge two intervals ([a, v] and [v, b]) which are known to be good.
-		// Captures temporary variables by reference to avoid multiple allocation
-		auto Merge2GoodInt = [&](uint32_t a, uint32_t v, uint32_t b){
-			
-			// Main principle:
-			// 1. Find potential points in intervals [a,v) and (v, b]
-			//    (i.e. the points that could make a new f-joint with any point form opposite interval).
-			//    Those points are find using cummin and cummac starting from v.
-			//     Some points might be dropped out before actual checking, but experiment showed, that it is not worthwhile.
-			// 2. Sequentially check all possible joints. If any increase is detected, then all middle points are insignificant.
-			
-			if (a==v || v==b) return ; // nothing to calculate, exit the procedure.
-			
-			double amin, amax, bmin, bmax, ev, balance, maxbalance, fjoin, takefjoin;
-			std::vector<pvtemppoint>::iterator ait, bit, tait, tbit, sbit;
-			uint32_t prt_it;
-			pvtemppoint pvtp;
-			
-			// 1. ### Find potential points
-			av_mins.clear();
-			av_maxs.clear();
-			vb_mins.clear();
-			vb_maxs.clear();
-			
-			// --- in interval [a,v) (starting from v).
-			ev = 0;
-			prt_it = v;
-			amin = amax = x[v];
-			while(prt_it!=a){
-				ev += links[prt_it].pvdiff;
-				prt_it = links[prt_it].prev;
-				if(x[prt_it]>amax){
-					amax=x[prt_it];
-					pvtp.it = prt_it;
-					pvtp.ev = ev;
-					av_maxs.push_back (pvtp);
-				} else if(x[prt_it]<amin){
-					amin = x[prt_it];
-					pvtp.it = prt_it;
-					pvtp.ev = ev;
-					av_mins.push_back (pvtp);
-				}
+		double amin, amax, bmin, bmax, ev, balance, maxbalance, fjoin, takefjoin;
+		typename std::vector<basic_pvtemppoint<index_t> >::iterator ait, bit, tait, tbit, sbit;
+		index_t prt_it;
+		basic_pvtemppoint<index_t> pvtp;
+		
+		// 1. ### Find potential points
+		av_mins.clear();
+		av_maxs.clear();
+		vb_mins.clear();
+		vb_maxs.clear();
+		
+		// --- in interval [a,v) (starting from v).
+		ev = 0;
+		prt_it = v;
+		amin = amax = x[v];
+		while(prt_it!=a){
+			ev += links[prt_it].pvdiff;
+			prt_it = links[prt_it].prev;
+			if(x[prt_it]>amax){
+				amax=x[prt_it];
+				pvtp.it = prt_it;
+				pvtp.ev = ev;
+				av_maxs.push_back (pvtp);
+			} else if(x[prt_it]<amin){
+				amin = x[prt_it];
+				pvtp.it = prt_it;
+				pvtp.ev = ev;
+				av_mins.push_back (pvtp);
 			}
-			
-			// --- in interval (v,b] (starting from v).
-			ev = 0;
-			prt_it = v;
-			bmin = bmax = x[v];
-			while(prt_it!=b){
-				prt_it = links[prt_it].next;
-				ev += links[prt_it].pvdiff;
-				if(x[prt_it]>bmax){
-					bmax = x[prt_it];
-					pvtp.it = prt_it;
-					pvtp.ev = ev;
-					vb_maxs.push_back (pvtp);
-				} else if( x[prt_it]<bmin){
-					bmin = x[prt_it];
-					pvtp.it = prt_it;
-					pvtp.ev = ev;
-					vb_mins.push_back (pvtp);
-				}
+		}
+		
+		// --- in interval (v,b] (starting from v).
+		ev = 0;
+		prt_it = v;
+		bmin = bmax = x[v];
+		while(prt_it!=b){
+			prt_it = links[prt_it].next;
+			ev += links[prt_it].pvdiff;
+			if(x[prt_it]>bmax){
+				bmax = x[prt_it];
+				pvtp.it = prt_it;
+				pvtp.ev = ev;
+				vb_maxs.push_back (pvtp);
+			} else if( x[prt_it]<bmin){
+				bmin = x[prt_it];
+				pvtp.it = prt_it;
+				pvtp.ev = ev;
+				vb_mins.push_back (pvtp);
 			}
-			
-			// 2. ### Sequentially check all possible joints: finding the best i,j \in [a, v)x(v,b] that could be joined
-			takefjoin = 0;
-			maxbalance = 0;
+		}
+		
+		// 2. ### Sequentially check all possible joints: finding the best i,j \in [a, v)x(v,b] that could be joined
+		//    The lists are in the order of growing ev, and of falling (av_mins, vb_mins) or growing (av_maxs, vb_maxs) x.
+		//    So for a point of av_mins, no point of vb_maxs after bit gives a larger balance than
+		//    |x[ait] - x[last of vb_maxs]|^p - bit.ev - ait.ev, and the scan over vb_maxs stops once this is at most maxbalance;
+		//    likewise the scan over av_mins stops once |x[last of av_mins] - x[last of vb_maxs]|^p - sbit.ev - ait.ev is.
+		//    The bounds are computed in the same order as balance, so the result is exactly the same as without them.
+		takefjoin = 0;
+		maxbalance = 0;
+		if (!av_mins.empty() && !vb_maxs.empty()) {
+			double bmax_last = x[vb_maxs.back().it];
+			double fjoin_largest = pvar_diff(x[av_mins.back().it] - bmax_last, p);
 			sbit = vb_maxs.begin();
 			for(ait=av_mins.begin(); ait!=av_mins.end(); ait++){
+				if (fjoin_largest - (*sbit).ev - (*ait).ev <= maxbalance) {
+					break;
+				}
+				double fjoin_bound = pvar_diff(x[(*ait).it] - bmax_last, p);
 				for(bit=sbit; bit!=vb_maxs.end(); bit++){
+					if (fjoin_bound - (*bit).ev - (*ait).ev <= maxbalance) {
+						break;
+					}
 					fjoin = pvar_diff( x[(*ait).it] - x[(*bit).it], p );
+					P_VAR_REAL_STAT(pvar_stats().merge_candidates++);
 					balance = fjoin - (*bit).ev - (*ait).ev ;
 					if (balance>maxbalance){
 						maxbalance = balance;
@@ -216,11 +298,23 @@ namespace p_var_real {
 					}
 				}
 			}
-			
+		}
+		
+		if (!av_maxs.empty() && !vb_mins.empty()) {
+			double bmin_last = x[vb_mins.back().it];
+			double fjoin_largest = pvar_diff(x[av_maxs.back().it] - bmin_last, p);
 			sbit = vb_mins.begin();
 			for(ait=av_maxs.begin(); ait!=av_maxs.end(); ait++){
+				if (fjoin_largest - (*sbit).ev - (*ait).ev <= maxbalance) {
+					break;
+				}
+				double fjoin_bound = pvar_diff(x[(*ait).it] - bmin_last, p);
 				for(bit=sbit; bit!=vb_mins.end(); bit++){
+					if (fjoin_bound - (*bit).ev - (*ait).ev <= maxbalance) {
+						break;
+					}
 					fjoin = pvar_diff( x[(*ait).it] - x[(*bit).it], p );
+					P_VAR_REAL_STAT(pvar_stats().merge_candidates++);
 					balance = fjoin - (*bit).ev - (*ait).ev ;
 					if (balance>maxbalance){
 						maxbalance = balance;
@@ -230,81 +324,1008 @@ namespace p_var_real {
 					}
 				}
 			}
-			
-			// if we found any point, join it by erasing all middle points
-			if(maxbalance>0){
-				links[(*tait).it].next = (*tbit).it;
-				links[(*tbit).it].prev = (*tait).it;
-				links[(*tbit).it].pvdiff = takefjoin;
-			}
-		};
+		}
 		
-		uint32_t it = 0;
-		std::list<uint32_t> IterList;
-		std::list<uint32_t>::iterator a_IL, v_IL, b_IL;
+		// if we found any point, join it by erasing all middle points
+		if(maxbalance>0){
+			links[(*tait).it].next = (*tbit).it;
+			links[(*tbit).it].prev = (*tait).it;
+			links[(*tbit).it].pvdiff = takefjoin;
+		}
+		return maxbalance;
+	}
+	
+	// Merge optimal intervals. LSI is the length of optimal intervals in the beginning.
+	template <typename index_t, typename power_t>
+	void MergeIntervalsRecursively(const double* x, index_t n, basic_workspace<index_t> & ws, const power_t& p, const uint32_t LSI=2){
+		
+		// Main principle:
+		// 1. Put endpoints of optimal intervals in IterList
+		// 2. Merge pairs of adjacent intervals using the function Merge2GoodInt. Repeat until all intervals are merged.
+		
+		basic_DoublyLinkedList<index_t> & links = ws.links;
+		basic_MergeBuffers<index_t> & tmp = ws.merge;
+		std::vector<index_t> & IterList = ws.IterList;
+		
+		index_t it = 0;
+		IterList.clear();
 		
 		// 1. ### Finding all the intervals that will be merged
-		int count = 0;
-		while(it < x.size()){
+		index_t count = 0;
+		while(it < n){
 			if(count % LSI == 0){
 				IterList.push_back (it);
 			}
 			++count;
 			it = links[it].next;
 		}
-		IterList.push_back (x.size()-1);
+		IterList.push_back (n-1);
 		
 		// ### 2. Merging pairs of interval until everything is merged.
-		// std::list<T>::size has constant complexity since C++11
+		// After merging [IterList[2k], IterList[2k+1]] and [IterList[2k+1], IterList[2k+2]]
+		// the middle point is dropped, compacting IterList in place.
 		while(IterList.size()>2){
-			a_IL = IterList.begin();
-			while (true){
-				// we are guaranteed that a_IL != IterList.end() here
-				v_IL = a_IL;
-				++v_IL;
-				if (v_IL != IterList.end())
-				{
-					b_IL = v_IL;
-					++b_IL;
-					if (b_IL != IterList.end()){
-						Merge2GoodInt(*a_IL, *v_IL, *b_IL);
-						a_IL = IterList.erase(v_IL); // now a_IL == b_IL
-					} else {
-						break;
-					}
-				} else {
-					break;
-				}
+			size_t len = IterList.size();
+			size_t kept = 1;
+			for (size_t i = 0; i + 2 < len; i += 2){
+				Merge2GoodInt(x, links, p, tmp, IterList[i], IterList[i+1], IterList[i+2]);
+				IterList[kept++] = IterList[i+2];
+			}
+			if (len % 2 == 0){
+				// the last interval has no pair on this level
+				IterList[kept++] = IterList[len-1];
 			}
+			IterList.resize(kept);
+		}
+	}
+	
+	// keep only the points of x which DetectLocalExtrema finds, i.e. the end points and local extrema.
+	// This does not change the p-variation for any p.
+	template <typename index_t>
+	NumericVector ExtractLocalExtrema(const double* x, index_t n){
+		basic_DoublyLinkedList<index_t> links(n);
+		DetectLocalExtrema<index_t>(x, n, links, pvar_power<1>());
+		
+		NumericVector extrema;
+		index_t i = 0;
+		while ( i < n ){
+			extrema.push_back(x[i]);
+			i = links[i].next;
+		}
+		return extrema;
+	}
+	
+	// link all points of x, which is supposed to consist of local extrema only
+	template <typename index_t, typename power_t>
+	void LinkAllPoints(const double* x, index_t n, basic_DoublyLinkedList<index_t> & links, const power_t& p){
+		for(index_t i = 0 ; i<n ; i++) {
+			links[i].prev = (i > 0) ? i-1 : 0;
+			links[i].next = i+1;
+			links[i].pvdiff = (i > 0) ? pvar_diff(x[i] - x[i-1], p) : 0.0;
 		}
 	}
 	
+	// p-variation of x, when ws.links already contain local extrema of x
+	template <typename index_t, typename power_t>
+	double pvar_from_extrema(const double* x, index_t n, basic_workspace<index_t> & ws, const power_t& p) {
+		CheckShortIntervals(x, n, ws.links, p);
+		MergeIntervalsRecursively(x, n, ws, p, 4);
+		
+		// output:
+		double pvalue=0;
+		index_t i = 0;
+		while ( i < n ){
+			pvalue += ws.links[i].pvdiff;
+			i = ws.links[i].next;
+		}
+		
+		return pvalue;
+	}
+	
 	// p-variation calculation (in C++)
-	double pvar(const NumericVector& x, double p) {
+	template <typename index_t, typename power_t>
+	double pvar_indexed(const double* x, index_t n, const power_t& p, basic_workspace<index_t> & ws) {
 		
 		// short special cases
-		if (x.size() <= 2) {
-			if (x.size() <= 1) {
+		if (n <= 2) {
+			if (n <= 1) {
 				return 0;
 			} else {
-				return std::pow(std::abs(x[0]-x[1]), p);
+				return pvar_diff(x[0] - x[1], p);
 			}
 		}
 		
-		DoublyLinkedList links(x.size());
+		// only grows, pointdata needs no initialisation
+		if (ws.links.size() < n) {
+			ws.links.resize(n);
+		}
 
-		DetectLocalExtrema(x, links,  p);
-		CheckShortIntervals(x, links, p);
-		MergeIntervalsRecursively(x, links, p, 4);
+		DetectLocalExtrema(x, n, ws.links,  p);
+		return pvar_from_extrema(x, n, ws, p);
+	}
+	
+	// 32-bit indices are enough for x with less than UINT32_MAX points
+	bool fits_uint32(size_t n) {
+		return n < UINT32_MAX;
+	}
+	
+	double pvar(const NumericVector& x, double p) {
+		workspace ws;
+		return pvar(x.data(), x.size(), p, ws);
+	}
+	
+	double pvar(const double* x, size_t n, double p) {
+		workspace ws;
+		return pvar(x, n, p, ws);
+	}
+	
+	template <typename index_t>
+	double pvar(const NumericVector& x, double p, basic_workspace<index_t> & ws) {
+		if (x.size() >= std::numeric_limits<index_t>::max()) {
+			throw std::length_error("pvar: too many points for the index type of the workspace");
+		}
+		return WithPower(p, [&](auto power){
+			return pvar_indexed<index_t>(x.data(), x.size(), power, ws);
+		});
+	}
+	template double pvar<uint32_t>(const NumericVector& x, double p, basic_workspace<uint32_t> & ws);
+	template double pvar<uint64_t>(const NumericVector& x, double p, basic_workspace<uint64_t> & ws);
+	
+	double pvar(const NumericVector& x, double p, workspace & ws) {
+		return pvar(x.data(), x.size(), p, ws);
+	}
+	
+	// pvar with the index type chosen by n
+	template <typename power_t>
+	double PvarAnyIndex(const double* x, size_t n, const power_t& p, workspace & ws) {
+		if (fits_uint32(n)) {
+			return pvar_indexed<uint32_t>(x, n, p, ws.ws32);
+		} else {
+			return pvar_indexed<uint64_t>(x, n, p, ws.ws64);
+		}
+	}
+	
+	double pvar(const double* x, size_t n, double p, workspace & ws) {
+		return WithPower(p, [&](auto power){
+			return PvarAnyIndex(x, n, power, ws);
+		});
+	}
+	
+	// reduced forms
+	NumericVector pvar_extrema(const NumericVector& x) {
+		return pvar_extrema(x.data(), x.size());
+	}
+	
+	NumericVector pvar_extrema(const double* x, size_t n) {
+		if (n <= 2) {
+			return NumericVector(x, x + n);
+		} else if (fits_uint32(n)) {
+			return ExtractLocalExtrema<uint32_t>(x, n);
+		} else {
+			return ExtractLocalExtrema<uint64_t>(x, n);
+		}
+	}
+	
+	template <typename index_t, typename power_t>
+	double pvar_reduced_indexed(const double* e, index_t n, const power_t& p, basic_workspace<index_t> & ws) {
+		if (n <= 2) {
+			return (n <= 1) ? 0 : pvar_diff(e[0] - e[1], p);
+		}
+		ws.links.resize(n);
+		LinkAllPoints<index_t>(e, n, ws.links, p);
+		return pvar_from_extrema(e, n, ws, p);
+	}
+	
+	double pvar_reduced(const double* e, size_t n, double p) {
+		workspace ws;
+		return WithPower(p, [&](auto power){
+			if (fits_uint32(n)) {
+				return pvar_reduced_indexed<uint32_t>(e, n, power, ws.ws32);
+			} else {
+				return pvar_reduced_indexed<uint64_t>(e, n, power, ws.ws64);
+			}
+		});
+	}
+	
+	// p-variation for many exponents: local extrema are found only once
+	template <typename index_t>
+	std::vector<double> pvar_multi_indexed(const double* x, index_t n, const std::vector<double>& ps) {
+		std::vector<double> pvalues;
+		pvalues.reserve(ps.size());
+		
+		NumericVector extrema = ExtractLocalExtrema<index_t>(x, n);
+		basic_workspace<index_t> ws;
+		ws.links.resize(extrema.size());
+		for (double p : ps) {
+			pvalues.push_back(WithPower(p, [&](auto power){
+				if (extrema.size() <= 2) {
+					return pvar_indexed<index_t>(extrema.data(), extrema.size(), power, ws);
+				}
+				LinkAllPoints<index_t>(extrema.data(), extrema.size(), ws.links, power);
+				return pvar_from_extrema<index_t>(extrema.data(), extrema.size(), ws, power);
+			}));
+		}
+		return pvalues;
+	}
+	
+	std::vector<double> pvar_multi(const NumericVector& x, const std::vector<double>& ps) {
+		return pvar_multi(x.data(), x.size(), ps);
+	}
+	
+	std::vector<double> pvar_multi(const double* x, size_t n, const std::vector<double>& ps) {
+		if (n <= 2) {
+			std::vector<double> pvalues;
+			for (double p : ps) {
+				pvalues.push_back(pvar(x, n, p));
+			}
+			return pvalues;
+		}
+		if (fits_uint32(n)) {
+			return pvar_multi_indexed<uint32_t>(x, n, ps);
+		} else {
+			return pvar_multi_indexed<uint64_t>(x, n, ps);
+		}
+	}
+	
+	// ------------------------------------ parallel version ----------------------------------- //
+	// call f(i, t) for i = 0,...,count-1 on at most threads threads, t < threads is the number of the thread
+	template <typename func_t>
+	void ParallelForThreads(size_t count, unsigned threads, func_t f){
+		std::atomic<size_t> next(0);
+		auto worker = [&](unsigned t){
+			for (size_t i = next++; i < count; i = next++) {
+				f(i, t);
+			}
+		};
+		std::vector<std::thread> pool;
+		for (unsigned t = 1; t < threads && t < count; t++) {
+			pool.emplace_back(worker, t);
+		}
+		worker(0);
+		for (auto & t : pool) {
+			t.join();
+		}
+	}
+	
+	// call f(i) for i = 0,...,count-1 on at most threads threads
+	template <typename func_t>
+	void ParallelFor(size_t count, unsigned threads, func_t f){
+		ParallelForThreads(count, threads, [&f](size_t i, unsigned){
+			f(i);
+		});
+	}
+	
+	// optimal partition of the chunk x[0..n-1], appended to partition
+	template <typename index_t, typename power_t>
+	void OptimalPartition(const double* x, index_t n, const power_t& p, NumericVector & partition) {
+		basic_workspace<index_t> ws;
+		ws.links.resize(n);
+		DetectLocalExtrema(x, n, ws.links, p);
+		CheckShortIntervals(x, n, ws.links, p);
+		MergeIntervalsRecursively(x, n, ws, p, 4);
+		for (index_t j = 0; j < n; j = ws.links[j].next) {
+			partition.push_back(x[j]);
+		}
+	}
+	
+	// merge good intervals [ends[k], ends[k+1]] of reduced level by level into links
+	template <typename index_t, typename power_t>
+	void MergeChunkLinks(const NumericVector& reduced, std::vector<index_t> ends, const power_t& p, unsigned threads,
+			basic_DoublyLinkedList<index_t> & links) {
+		links.resize(reduced.size());
+		LinkAllPoints<index_t>(reduced.data(), reduced.size(), links, p);
+		std::vector<basic_MergeBuffers<index_t> > tmp(ends.size() / 2);
+		while (ends.size() > 2) {
+			size_t pairs = (ends.size() - 1) / 2;
+			ParallelFor(pairs, threads, [&](size_t i){
+				Merge2GoodInt(reduced.data(), links, p, tmp[i], ends[2*i], ends[2*i+1], ends[2*i+2]);
+			});
+			std::vector<index_t> next_ends;
+			for (size_t i = 0; i < ends.size(); i += 2) {
+				next_ends.push_back(ends[i]);
+			}
+			if (ends.size() % 2 == 0) {
+				next_ends.push_back(ends.back());
+			}
+			ends.swap(next_ends);
+		}
+	}
+	
+	// p-variation of reduced, whose intervals [ends[k], ends[k+1]] are good
+	template <typename index_t, typename power_t>
+	double MergeChunks(const NumericVector& reduced, const std::vector<index_t>& ends, const power_t& p, unsigned threads) {
+		basic_DoublyLinkedList<index_t> links;
+		MergeChunkLinks(reduced, ends, p, threads, links);
 		
 		// output:
 		double pvalue=0;
-		uint32_t i = 0;
-		while ( i < x.size() ){
+		index_t i = 0;
+		while ( i < reduced.size() ){
 			pvalue += links[i].pvdiff;
 			i = links[i].next;
 		}
 		
 		return pvalue;
 	}
+	
+	// replace reduced by its optimal partition, a single good interval
+	template <typename index_t, typename power_t>
+	void CompactChunks(NumericVector& reduced, std::vector<size_t>& ends, const power_t& p) {
+		basic_DoublyLinkedList<index_t> links;
+		MergeChunkLinks<index_t>(reduced, std::vector<index_t>(ends.begin(), ends.end()), p, 1, links);
+		NumericVector partition;
+		for (size_t j = 0; j < reduced.size(); j = links[j].next) {
+			partition.push_back(reduced[j]);
+		}
+		reduced.swap(partition);
+		ends.assign(1, 0);
+		ends.push_back(reduced.size() - 1);
+	}
+	
+	// p-variation of packed sequences
+	std::vector<double> pvar_batch(const NumericVector& values, const std::vector<size_t>& offsets, double p, unsigned threads) {
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		size_t count = offsets.empty() ? 0 : offsets.size() - 1;
+		std::vector<double> pvs(count);
+		// one workspace per thread, reused for all its sequences and freed on return
+		std::vector<workspace> workspaces(std::max<size_t>(1, std::min<size_t>(threads, count)));
+		WithPower(p, [&](auto power){
+			ParallelForThreads(count, threads, [&](size_t i, unsigned t){
+				pvs[i] = PvarAnyIndex(values.data() + offsets[i], offsets[i+1] - offsets[i], power, workspaces[t]);
+			});
+		});
+		return pvs;
+	}
+	
+	// p-variation of a sequence read in chunks
+	double pvar_chunked(const std::function<size_t(double*, size_t)>& read, double p, size_t chunk_size) {
+		
+		// Same as pvar_parallel, with chunks processed one after another as they are read:
+		// each chunk starts with the last value of the previous one.
+		// Once the partitions of the chunks have more than max(chunk_size, 2 * compacted) points,
+		// where compacted is the size after the last time, they are merged into one.
+		
+		chunk_size = std::max<size_t>(chunk_size, 3);
+		NumericVector chunk(chunk_size);
+		NumericVector partition;
+		NumericVector reduced;
+		std::vector<size_t> ends(1, 0);
+		size_t compacted = 0;
+		
+		// fill chunk[n..], returns the new number of values in chunk
+		auto fill = [&](size_t n) {
+			while (n < chunk_size) {
+				size_t k = read(chunk.data() + n, chunk_size - n);
+				if (k == 0) {
+					break;
+				}
+				n += k;
+			}
+			return n;
+		};
+		
+		return WithPower(p, [&](auto power){
+			size_t n = fill(0);
+			if (n < chunk_size) {
+				workspace ws;
+				return PvarAnyIndex(chunk.data(), n, power, ws);
+			}
+			while (n > 1) {
+				partition.clear();
+				if (fits_uint32(n)) {
+					OptimalPartition<uint32_t>(chunk.data(), n, power, partition);
+				} else {
+					OptimalPartition<uint64_t>(chunk.data(), n, power, partition);
+				}
+				reduced.insert(reduced.end(), partition.begin() + (reduced.empty() ? 0 : 1), partition.end());
+				ends.push_back(reduced.size() - 1);
+				if (reduced.size() > std::max(chunk_size, 2 * compacted)) {
+					if (fits_uint32(reduced.size())) {
+						CompactChunks<uint32_t>(reduced, ends, power);
+					} else {
+						CompactChunks<uint64_t>(reduced, ends, power);
+					}
+					compacted = reduced.size();
+				}
+				chunk[0] = chunk[n - 1];
+				n = fill(1);
+			}
+			
+			if (fits_uint32(reduced.size())) {
+				return MergeChunks<uint32_t>(reduced, std::vector<uint32_t>(ends.begin(), ends.end()), power, 1);
+			} else {
+				return MergeChunks<uint64_t>(reduced, std::vector<uint64_t>(ends.begin(), ends.end()), power, 1);
+			}
+		});
+	}
+	
+	double pvar_file(const std::string& file_name, double p, size_t max_memory) {
+		std::FILE* file = std::fopen(file_name.c_str(), "rb");
+		if (file == NULL) {
+			throw std::system_error(errno, std::system_category(), "cannot open " + file_name);
+		}
+		// per value of a chunk: the value and at most one partition point; and while the partitions
+		// of up to two chunks are compacted, per point: the point, its pointdata and the compacted copy
+		size_t chunk_size = max_memory / (6 * sizeof(double) + 2 * sizeof(basic_pointdata<uint32_t>));
+		bool failed = false;
+		double pv = pvar_chunked([&](double* buffer, size_t k) {
+			size_t count = std::fread(buffer, sizeof(double), k, file);
+			failed = failed || std::ferror(file);
+			return count;
+		}, p, chunk_size);
+		int code = errno;
+		std::fclose(file);
+		if (failed) {
+			throw std::system_error(code, std::system_category(), "cannot read " + file_name);
+		}
+		return pv;
+	}
+	
+	// p-variation of all prefixes of x
+	template <typename index_t, typename power_t>
+	void PrefixPvar(const double* x, index_t n, const power_t& p, double* out) {
+		
+		// Main principle:
+		// the optimal partition of x[0..j-1] and [j-1, j] are good intervals, so the optimal partition
+		// of x[0..j] consists of a part of the first one, up to some point k, followed by j
+		// (this is what Merge2GoodInt finds with the single point j on the right).
+		// The part up to k is optimal for x[0..k], so
+		//   out[j] = max{out[k] + |x[j] - x[k]|^p : k in the partition of x[0..j-1]}.
+		// The partition is kept as a stack of points. To find k quickly, complete dyadic blocks
+		// of stack positions store the min and max of x: all k in a block are skipped when
+		// out at the end of the block (out increases along the stack) plus the largest join
+		// with the block is not more than the best value so far.
+		
+		if (n == 0) {
+			return;
+		}
+		std::vector<index_t> stack(1, 0);
+		// lo[l][b], hi[l][b]: min and max of x over the stack positions [b << l, (b + 1) << l), l >= 1
+		std::vector<std::vector<double> > lo(1), hi(1);
+		out[0] = 0;
+		for (index_t j = 1; j < n; j++) {
+			size_t e = stack.size() - 1;
+			index_t best = stack[e];
+			double max_pvalue = out[best] + pvar_diff(x[j] - x[best], p);
+			
+			// dyadic blocks of the positions [0, e), from the top of the stack down
+			while (e > 0) {
+				size_t l = 0;
+				while (((e >> l) & 1) == 0 && l + 1 < lo.size()) {
+					l++;
+				}
+				for (; l > 0; l--) {
+					size_t b = (e >> l) - 1;
+					double join = std::max(x[j] - lo[l][b], hi[l][b] - x[j]);
+					if (out[stack[e - 1]] + pvar_diff(join, p) <= max_pvalue) {
+						break;
+					}
+				}
+				if (l == 0) {
+					index_t k = stack[e - 1];
+					double pvalue = out[k] + pvar_diff(x[j] - x[k], p);
+					P_VAR_REAL_STAT(pvar_stats().merge_candidates++);
+					if (pvalue > max_pvalue) {
+						max_pvalue = pvalue;
+						best = k;
+					}
+					e--;
+				} else {
+					e -= size_t(1) << l;
+				}
+			}
+			out[j] = max_pvalue;
+			
+			// the optimal partition of x[0..j]: drop the stack above best and push j
+			while (stack.back() != best) {
+				stack.pop_back();
+			}
+			stack.push_back(j);
+			// complete the blocks ending at the new top
+			size_t q = stack.size();
+			for (size_t l = 1; q % (size_t(1) << l) == 0; l++) {
+				if (lo.size() <= l) {
+					lo.emplace_back();
+					hi.emplace_back();
+				}
+				size_t b = (q >> l) - 1;
+				double left_lo, left_hi, right_lo, right_hi;
+				if (l == 1) {
+					left_lo = left_hi = x[stack[q - 2]];
+					right_lo = right_hi = x[stack[q - 1]];
+				} else {
+					left_lo = lo[l-1][2*b];
+					left_hi = hi[l-1][2*b];
+					right_lo = lo[l-1][2*b+1];
+					right_hi = hi[l-1][2*b+1];
+				}
+				lo[l].resize(b + 1);
+				hi[l].resize(b + 1);
+				lo[l][b] = std::min(left_lo, right_lo);
+				hi[l][b] = std::max(left_hi, right_hi);
+			}
+		}
+	}
+	
+	std::vector<double> pvar_prefix(const NumericVector& x, double p) {
+		return pvar_prefix(x.data(), x.size(), p);
+	}
+	
+	std::vector<double> pvar_prefix(const double* x, size_t n, double p) {
+		std::vector<double> prefix(n);
+		pvar_prefix(x, n, p, prefix.data());
+		return prefix;
+	}
+	
+	void pvar_prefix(const double* x, size_t n, double p, double* out) {
+		WithPower(p, [&](auto power){
+			if (fits_uint32(n)) {
+				PrefixPvar<uint32_t>(x, n, power, out);
+			} else {
+				PrefixPvar<uint64_t>(x, n, power, out);
+			}
+		});
+	}
+	
+	// summaries of chunks
+	pvar_summary pvar_summarize(const NumericVector& x, double p) {
+		return pvar_summarize(x.data(), x.size(), p);
+	}
+	
+	template <typename power_t>
+	pvar_summary Summarize(const double* x, size_t n, double p, const power_t& power) {
+		pvar_summary summary;
+		summary.p = p;
+		if (n <= 2) {
+			summary.points.assign(x, x + n);
+		} else if (fits_uint32(n)) {
+			OptimalPartition<uint32_t>(x, n, power, summary.points);
+		} else {
+			OptimalPartition<uint64_t>(x, n, power, summary.points);
+		}
+		return summary;
+	}
+	
+	pvar_summary pvar_summarize(const double* x, size_t n, double p) {
+		return WithPower(p, [&](auto power){
+			return Summarize(x, n, p, power);
+		});
+	}
+	
+	// sum of the p-th powers of the increments of points
+	template <typename power_t>
+	double PartitionValue(const NumericVector& points, const power_t& p) {
+		double pvalue = 0;
+		for (size_t i = 1; i < points.size(); i++) {
+			pvalue += pvar_diff(points[i] - points[i-1], p);
+		}
+		return pvalue;
+	}
+	
+	double pvar_summary::value() const {
+		return WithPower(p, [&](auto power){
+			return PartitionValue(points, power);
+		});
+	}
+	
+	// optimal partition of the concatenation of two optimal partitions left and right
+	template <typename index_t, typename power_t>
+	void MergeSummaries(const NumericVector& left, const NumericVector& right, const power_t& p, NumericVector& points) {
+		
+		// [0, nl-1] and [nl, n-1] are good intervals, and so is [nl-1, nl] which has no middle points,
+		// so they can be merged with Merge2GoodInt one after another.
+		
+		NumericVector reduced(left);
+		reduced.insert(reduced.end(), right.begin(), right.end());
+		index_t n = reduced.size();
+		index_t nl = left.size();
+		basic_DoublyLinkedList<index_t> links(n);
+		LinkAllPoints<index_t>(reduced.data(), n, links, p);
+		basic_MergeBuffers<index_t> tmp;
+		Merge2GoodInt<index_t>(reduced.data(), links, p, tmp, 0, nl - 1, nl);
+		Merge2GoodInt<index_t>(reduced.data(), links, p, tmp, 0, nl, n - 1);
+		
+		points.clear();
+		for (index_t j = 0; j < n; j = links[j].next) {
+			points.push_back(reduced[j]);
+		}
+	}
+	
+	template <typename power_t>
+	pvar_summary Merge(const pvar_summary& left, const pvar_summary& right, const power_t& power) {
+		if (left.points.empty()) {
+			return right;
+		}
+		if (right.points.empty()) {
+			return left;
+		}
+		if (left.p != right.p) {
+			throw std::invalid_argument("pvar_summary: cannot merge summaries for different p");
+		}
+		pvar_summary summary;
+		summary.p = left.p;
+		if (fits_uint32(left.points.size() + right.points.size())) {
+			MergeSummaries<uint32_t>(left.points, right.points, power, summary.points);
+		} else {
+			MergeSummaries<uint64_t>(left.points, right.points, power, summary.points);
+		}
+		return summary;
+	}
+	
+	pvar_summary pvar_merge(const pvar_summary& left, const pvar_summary& right) {
+		return WithPower(left.p, [&](auto power){
+			return Merge(left, right, power);
+		});
+	}
+	
+	// whether the p-variation of a prefix of x exceeds threshold; it is at most that of x
+	template <typename index_t, typename power_t>
+	bool PrefixExceeds(const double* x, size_t n, const power_t& p, double threshold) {
+		
+		// Same as pvar_chunked: each chunk starts with the last value of the previous one,
+		// and the partitions of the chunks are merged into one once they have more than
+		// max(chunk_size, 2 * compacted) points, so that the merges do not rescan the whole prefix per chunk.
+		// In between, the sum of the values of the merged partition and of the chunks after it
+		// is a lower bound of the p-variation of the prefix, since joining intervals only adds partitions.
+		
+		const size_t chunk_size = size_t(1) << 16;
+		NumericVector partition;
+		NumericVector reduced;
+		std::vector<size_t> ends(1, 0);
+		size_t compacted = 0;
+		double pvalue = 0;
+		auto compact = [&]() {
+			CompactChunks<index_t>(reduced, ends, p);
+			compacted = reduced.size();
+			pvalue = PartitionValue(reduced, p);
+		};
+		for (size_t i = 0; i + 1 < n; i += chunk_size) {
+			partition.clear();
+			OptimalPartition<uint32_t>(x + i, uint32_t(std::min(chunk_size + 1, n - i)), p, partition);
+			for (size_t j = 1; j < partition.size(); j++) {
+				pvalue += pvar_diff(partition[j] - partition[j-1], p);
+			}
+			reduced.insert(reduced.end(), partition.begin() + (reduced.empty() ? 0 : 1), partition.end());
+			ends.push_back(reduced.size() - 1);
+			if (pvalue > threshold) {
+				return true;
+			}
+			if (reduced.size() > std::max(chunk_size, 2 * compacted)) {
+				compact();
+				if (pvalue > threshold) {
+					return true;
+				}
+			}
+		}
+		if (ends.size() > 2) {
+			compact();
+		}
+		return pvalue > threshold;
+	}
+	
+	// comparison with a threshold
+	bool pvar_exceeds(const NumericVector& x, double p, double threshold) {
+		return pvar_exceeds(x.data(), x.size(), p, threshold);
+	}
+	
+	bool pvar_exceeds(const double* x, size_t n, double p, double threshold) {
+		if (n <= 1) {
+			return 0 > threshold;
+		}
+		
+		// every increment of a partition is at most max x - min x,
+		// and their sum is at most the sum of all increments
+		double length = 0;
+		double lo = x[0];
+		double hi = x[0];
+		for (size_t j = 1; j < n; j++) {
+			length += std::abs(x[j] - x[j-1]);
+			lo = std::min(lo, x[j]);
+			hi = std::max(hi, x[j]);
+		}
+		if (hi == lo) {
+			return 0 > threshold;
+		}
+		return WithPower(p, [&](auto power){
+			if (!(pvar_diff(hi - lo, power) / (hi - lo) * length > threshold)) {
+				return false;
+			}
+			if (fits_uint32(n)) {
+				return PrefixExceeds<uint32_t>(x, n, power, threshold);
+			} else {
+				return PrefixExceeds<uint64_t>(x, n, power, threshold);
+			}
+		});
+	}
+	
+	// p-variation of sub-intervals
+	pvar_index::pvar_index(const NumericVector& x) : x(x.data()), n(x.size()) {}
+	
+	pvar_index::pvar_index(const double* x, size_t n) : x(x), n(n) {}
+	
+	const pvar_index::tree_t& pvar_index::tree(double p) {
+		auto it = trees.find(p);
+		if (it != trees.end()) {
+			return it->second;
+		}
+		tree_t& levels = trees[p];
+		levels.emplace_back();
+		WithPower(p, [&](auto power){
+			for (size_t i = 0; i + block <= n; i += block) {
+				levels[0].push_back(Summarize(x + i, block, p, power));
+			}
+			while (levels.back().size() >= 2) {
+				const std::vector<pvar_summary>& lower = levels.back();
+				std::vector<pvar_summary> upper;
+				for (size_t i = 0; i + 1 < lower.size(); i += 2) {
+					upper.push_back(Merge(lower[i], lower[i+1], power));
+				}
+				levels.push_back(std::move(upper));
+			}
+		});
+		return levels;
+	}
+	
+	double pvar_index::query(size_t a, size_t b, double p) {
+		
+		// [a, b] is split into a partial block, whole blocks [lo, hi) and a partial block;
+		// whole blocks are covered from left to right by the largest aligned nodes of the tree.
+		
+		size_t lo = (a + block - 1) / block;
+		size_t hi = (b + 1) / block;
+		if (lo >= hi) {
+			return pvar(x + a, b - a + 1, p);
+		}
+		const tree_t& levels = tree(p);
+		return WithPower(p, [&](auto power){
+			pvar_summary summary = Summarize(x + a, lo * block - a, p, power);
+			while (lo < hi) {
+				size_t l = 0;
+				while (l + 1 < levels.size() && (lo >> (l + 1) << (l + 1)) == lo && lo + (size_t(2) << l) <= hi) {
+					l++;
+				}
+				summary = Merge(summary, levels[l][lo >> l], power);
+				lo += size_t(1) << l;
+			}
+			summary = Merge(summary, Summarize(x + hi * block, b + 1 - hi * block, p, power), power);
+			return PartitionValue(summary.points, power);
+		});
+	}
+	
+	// binary format: "pvsm", uint32_t version = 1, double p, uint64_t number of points, the points
+	void pvar_summary::write(std::ostream& out) const {
+		uint32_t version = 1;
+		uint64_t n = points.size();
+		out.write("pvsm", 4);
+		out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+		out.write(reinterpret_cast<const char*>(&p), sizeof(p));
+		out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+		out.write(reinterpret_cast<const char*>(points.data()), n * sizeof(double));
+	}
+	
+	pvar_summary pvar_summary::read(std::istream& in) {
+		char magic[4];
+		uint32_t version = 0;
+		uint64_t n = 0;
+		pvar_summary summary;
+		in.read(magic, 4);
+		in.read(reinterpret_cast<char*>(&version), sizeof(version));
+		in.read(reinterpret_cast<char*>(&summary.p), sizeof(summary.p));
+		in.read(reinterpret_cast<char*>(&n), sizeof(n));
+		if (!in || std::string(magic, 4) != "pvsm" || version != 1) {
+			throw std::runtime_error("pvar_summary: invalid header");
+		}
+		// read in pieces, so that a corrupted size does not allocate too much memory
+		const uint64_t piece = 1 << 16;
+		for (uint64_t k = 0; k < n && in; k += piece) {
+			size_t m = size_t(std::min(piece, n - k));
+			summary.points.resize(size_t(k) + m);
+			in.read(reinterpret_cast<char*>(summary.points.data() + k), m * sizeof(double));
+		}
+		if (!in) {
+			throw std::runtime_error("pvar_summary: truncated input");
+		}
+		return summary;
+	}
+	
+	// p-variation using several threads
+	double pvar_parallel(const NumericVector& x, double p, unsigned threads) {
+		return pvar_parallel(x.data(), x.size(), p, threads);
+	}
+	
+	double pvar_parallel(const double* x, size_t n, double p, unsigned threads) {
+		
+		// Main principle:
+		// 1. Split x into chunks sharing end points, and find an optimal partition of each chunk independently.
+		// 2. Each chunk is a good interval, so adjacent chunks can be merged with Merge2GoodInt,
+		//    working only on the points of the optimal partitions. Merges on each level are independent.
+		
+		const size_t min_chunk = 1 << 16;
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		size_t chunks = std::min<size_t>(threads, n / min_chunk);
+		if (chunks <= 1) {
+			return pvar(x, n, p);
+		}
+		
+		return WithPower(p, [&](auto power){
+			// 1. ### optimal partitions of chunks [bounds[i], bounds[i+1]]
+			std::vector<size_t> bounds(chunks + 1);
+			for (size_t i = 0; i <= chunks; i++) {
+				bounds[i] = (n - 1) / chunks * i;
+			}
+			bounds[chunks] = n - 1;
+			
+			std::vector<NumericVector> partitions(chunks);
+			ParallelFor(chunks, threads, [&](size_t i){
+				size_t chunk_n = bounds[i+1] - bounds[i] + 1;
+				if (fits_uint32(chunk_n)) {
+					OptimalPartition<uint32_t>(x + bounds[i], chunk_n, power, partitions[i]);
+				} else {
+					OptimalPartition<uint64_t>(x + bounds[i], chunk_n, power, partitions[i]);
+				}
+			});
+			
+			// values of partition points of all chunks, and positions of chunk end points among them
+			NumericVector reduced;
+			std::vector<size_t> ends(1, 0);
+			for (size_t i = 0; i < chunks; i++) {
+				reduced.insert(reduced.end(), partitions[i].begin() + (i > 0 ? 1 : 0), partitions[i].end());
+				ends.push_back(reduced.size() - 1);
+				NumericVector().swap(partitions[i]);
+			}
+			
+			// 2. ### merge adjacent chunks level by level
+			if (fits_uint32(reduced.size())) {
+				return MergeChunks<uint32_t>(reduced, std::vector<uint32_t>(ends.begin(), ends.end()), power, threads);
+			} else {
+				return MergeChunks<uint64_t>(reduced, std::vector<uint64_t>(ends.begin(), ends.end()), power, threads);
+			}
+		});
+	}
+	
+	// ------------------------------------ sliding window ------------------------------------- //
+	// positions in x[0..n-1] of its optimal partition
+	template <typename index_t, typename power_t>
+	void PartitionPositions(const double* x, index_t n, const power_t& p, basic_workspace<index_t> & ws, std::vector<size_t> & positions) {
+		positions.clear();
+		if (n <= 2) {
+			for (index_t j = 0; j < n; j++) {
+				positions.push_back(j);
+			}
+			return;
+		}
+		if (ws.links.size() < n) {
+			ws.links.resize(n);
+		}
+		DetectLocalExtrema(x, n, ws.links, p);
+		pvar_from_extrema(x, n, ws, p);
+		for (index_t j = 0; j < n; j = ws.links[j].next) {
+			positions.push_back(j);
+		}
+	}
+	
+	// seq[0..v] and seq[v..] are optimal partitions of two consecutive intervals (index and value),
+	// seq becomes the optimal partition of their union
+	template <typename index_t, typename power_t>
+	void MergePartitionsAt(std::vector<std::pair<size_t, double> > & seq, index_t v, const power_t& p, basic_workspace<index_t> & ws, NumericVector & values) {
+		index_t n = seq.size();
+		values.resize(n);
+		for (index_t j = 0; j < n; j++) {
+			values[j] = seq[j].second;
+		}
+		if (ws.links.size() < n) {
+			ws.links.resize(n);
+		}
+		LinkAllPoints<index_t>(values.data(), n, ws.links, p);
+		Merge2GoodInt<index_t>(values.data(), ws.links, p, ws.merge, 0, v, n - 1);
+		size_t k = 0;
+		for (index_t j = 0; j < n; j = ws.links[j].next) {
+			seq[k++] = seq[j];
+		}
+		seq.resize(k);
+	}
+	
+	template <typename power_t>
+	void MergePartitionsAt(std::vector<std::pair<size_t, double> > & seq, size_t v, const power_t& p, workspace & ws, NumericVector & values) {
+		if (fits_uint32(seq.size())) {
+			MergePartitionsAt<uint32_t>(seq, uint32_t(v), p, ws.ws32, values);
+		} else {
+			MergePartitionsAt<uint64_t>(seq, uint64_t(v), p, ws.ws64, values);
+		}
+	}
+	
+	pvar_window::pvar_window(size_t window, double p) : window(window < 1 ? 1 : window), p(p) {}
+	
+	void pvar_window::push(double x) {
+		// the last point becomes a turning point if the direction changes at it
+		if (!points.empty()) {
+			double last = points.back();
+			if ( (x > last && direction == -1) || (x < last && direction == 1) ) {
+				turning.push_back(std::make_pair(count - 1, last));
+			}
+			if (x > last) {
+				direction = 1;
+			} else if (x < last) {
+				direction = -1;
+			}
+		}
+		
+		points.push_back(x);
+		count++;
+		
+		// [first, count - 2] and [count - 2, count - 1] are good intervals
+		partition.push_back(std::make_pair(count - 1, x));
+		if (partition.size() > 2) {
+			WithPower(p, [&](auto power){
+				MergePartitionsAt(partition, partition.size() - 2, power, ws, values);
+			});
+		}
+		
+		if (points.size() > window) {
+			points.pop_front();
+			size_t first = count - points.size();
+			while (!turning.empty() && turning.front().first <= first) {
+				turning.pop_front();
+			}
+			drop_front();
+		}
+	}
+	
+	void pvar_window::drop_front() {
+		
+		// partition[0] has left the window, and partition[1..] is the optimal partition of
+		// [partition[1], count - 1], otherwise partition would not be optimal.
+		// So [first, partition[1]] is partitioned again and merged with it.
+		
+		size_t first = count - points.size();
+		if (partition[1].first == first) {
+			partition.erase(partition.begin());
+			return;
+		}
+		
+		// the end points and the turning points in between have the same p-variation
+		front.clear();
+		front.push_back(std::make_pair(first, points.front()));
+		for (const auto & t : turning) {
+			if (t.first >= partition[1].first) {
+				break;
+			}
+			front.push_back(t);
+		}
+		front.push_back(partition[1]);
+		values.resize(front.size());
+		for (size_t j = 0; j < front.size(); j++) {
+			values[j] = front[j].second;
+		}
+		WithPower(p, [&](auto power){
+			if (fits_uint32(front.size())) {
+				PartitionPositions<uint32_t>(values.data(), uint32_t(front.size()), power, ws.ws32, positions);
+			} else {
+				PartitionPositions<uint64_t>(values.data(), uint64_t(front.size()), power, ws.ws64, positions);
+			}
+			
+			for (size_t k = 0; k < positions.size(); k++) {
+				front[k] = front[positions[k]];
+			}
+			front.resize(positions.size());
+			size_t v = front.size() - 1;
+			front.insert(front.end(), partition.begin() + 2, partition.end());
+			partition.swap(front);
+			MergePartitionsAt(partition, v, power, ws, values);
+		});
+	}
+	
+	double pvar_window::value() const {
+		return WithPower(p, [&](auto power){
+			double pvalue = 0;
+			for (size_t i = 1; i < partition.size(); i++) {
+				pvalue += pvar_diff(partition[i].second - partition[i-1].second, power);
+			}
+			return pvalue;
+		});
+	}
 } // namespace p_var_real
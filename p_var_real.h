@@ -1,11 +1,232 @@
 #pragma once
 
 #include <vector>
+#include <deque>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <functional>
+#include <string>
+#include <iosfwd>
+#include <map>
 
 namespace p_var_real {
 	typedef std::vector<double> NumericVector;
 
-	// Compute p-variation of vector x, raised to the power p
-	// Assumption: size(x) < UINT_LEAST32_MAX
+	// Compute p-variation of vector x, raised to the power p.
+	// Indices are 32-bit when size(x) < UINT32_MAX and 64-bit otherwise.
+	// |d|^p is computed with std::pow, except for p = 1, 2, 3, 4 and 2.5, for which all functions here
+	// use multiplications and sqrt, chosen once per call. For p = 1 and 2 they give the same bits as std::pow;
+	// each |d|^p may differ from std::pow in the last bit for p = 3 and in the last two bits for p = 4 and 2.5,
+	// so the p-variation may differ from one computed with std::pow by about as much per term of the sum.
 	double pvar(const NumericVector& x, double p);
+	// Same for the n values x[0],...,x[n-1], e.g. in a memory mapped file (see mmap_path.h)
+	double pvar(const double* x, size_t n, double p);
+
+	// Same as pvar, but uses the buffers in ws, so that repeated calls do not allocate memory
+	// once ws has grown to the size of the longest x. That is the only gain,
+	// so it is noticeable only for short x, e.g. about twice as fast for 5 values.
+	struct workspace;
+	double pvar(const NumericVector& x, double p, workspace & ws);
+	double pvar(const double* x, size_t n, double p, workspace & ws);
+
+	// Same as pvar, with an explicit choice of the index type: uint32_t or uint64_t;
+	// throws std::length_error if size(x) is not less than the largest index_t
+	template <typename index_t>
+	struct basic_workspace;
+	template <typename index_t>
+	double pvar(const NumericVector& x, double p, basic_workspace<index_t> & ws);
+
+	// Compute p-variation of vector x for each p in ps,
+	// faster than calling pvar for each p separately
+	std::vector<double> pvar_multi(const NumericVector& x, const std::vector<double>& ps);
+	std::vector<double> pvar_multi(const double* x, size_t n, const std::vector<double>& ps);
+
+	// The first and last value of x and its local extrema in between, which have the same p-variation as x
+	// for every p. pvar_reduced computes it without searching for the local extrema again:
+	//   NumericVector e = pvar_extrema(x);
+	//   pvar_reduced(e.data(), e.size(), p) == pvar(x, p)
+	// e.g. for e cached in a file, see p_var_file.h.
+	NumericVector pvar_extrema(const NumericVector& x);
+	NumericVector pvar_extrema(const double* x, size_t n);
+	double pvar_reduced(const double* e, size_t n, double p);
+
+	// Compute p-variation of vector x using up to threads threads,
+	// threads = 0 means std::thread::hardware_concurrency()
+	double pvar_parallel(const NumericVector& x, double p, unsigned threads = 0);
+	double pvar_parallel(const double* x, size_t n, double p, unsigned threads = 0);
+
+	// Compute p-variation of many sequences packed into one vector: sequence i is
+	// values[offsets[i]], ..., values[offsets[i+1] - 1], so offsets has one more element than the result.
+	// Uses up to threads threads, threads = 0 means std::thread::hardware_concurrency().
+	// See p_var_offload.h for the same on an accelerator.
+	std::vector<double> pvar_batch(const NumericVector& values, const std::vector<size_t>& offsets, double p, unsigned threads = 0);
+
+	// Compute p-variation of a sequence which is read in chunks of chunk_size values:
+	// read(buffer, k) stores the next at most k values in buffer and returns their number, 0 at the end.
+	// Only one chunk and the optimal partitions of the chunks read so far are kept in memory,
+	// and those are merged into the optimal partition of all values read once they have more than
+	// chunk_size points and twice as many as after the last merge.
+	// So the memory is O(chunk_size + the size of the optimal partition of the sequence),
+	// which is bounded by the chunk size only when the partition is short, e.g. not for p close to 1.
+	double pvar_chunked(const std::function<size_t(double*, size_t)>& read, double p, size_t chunk_size = size_t(1) << 20);
+	// Same for a file of doubles in native byte order, using about max_memory bytes for chunks.
+	// Throws std::system_error if the file cannot be read.
+	double pvar_file(const std::string& file_name, double p, size_t max_memory = size_t(1) << 26);
+
+	// p-variation of every prefix: element j is pvar of x[0..j], computed in one pass
+	// which extends the optimal partition of x[0..j-1] by x[j].
+	// The last form writes the n values to out instead.
+	std::vector<double> pvar_prefix(const NumericVector& x, double p);
+	std::vector<double> pvar_prefix(const double* x, size_t n, double p);
+	void pvar_prefix(const double* x, size_t n, double p, double* out);
+
+	// Whether pvar(x, p) > threshold, stopping as soon as the answer is known:
+	// the p-variation of growing prefixes of x is kept while the optimal partitions of chunks are merged into it,
+	// and (max x - min x)^(p-1) * sum |x[j] - x[j-1]| is an upper bound computed first.
+	bool pvar_exceeds(const NumericVector& x, double p, double threshold);
+	bool pvar_exceeds(const double* x, size_t n, double p, double threshold);
+
+	// Compiled with -DP_VAR_STATS (both p_var_real.cpp and the caller), pvar counts in pvar_stats(),
+	// one pvar_stats_t per thread, accumulated until reset():
+	// * extrema: local extrema found by DetectLocalExtrema;
+	// * short_removed: points removed by CheckShortIntervals;
+	// * merge_candidates: pairs of points compared by Merge2GoodInt.
+	// Without P_VAR_STATS nothing is counted.
+#ifdef P_VAR_STATS
+	struct pvar_stats_t {
+		size_t extrema = 0;
+		size_t short_removed = 0;
+		size_t merge_candidates = 0;
+
+		void reset() {
+			*this = pvar_stats_t();
+		}
+	};
+	pvar_stats_t & pvar_stats();
+#endif
+
+	// Summary of a chunk of a sequence, for computing p-variation of a long sequence split into
+	// consecutive chunks, e.g. on different machines:
+	//   pvar_summary s = pvar_merge(pvar_summarize(x1, p), pvar_summarize(x2, p));
+	// then s.value() == pvar(x1 followed by x2, p), and s can be merged further with its neighbours.
+	// points are the values of x at an optimal partition of the chunk, including its first and last value;
+	// pvar_merge reuses Merge2GoodInt on them, which gives the same result as pvar on the whole sequence.
+	// write and read store a summary in a binary format, doubles in native byte order.
+	struct pvar_summary {
+		double p = 1;
+		NumericVector points;
+
+		// p-variation of the chunk
+		double value() const;
+		void write(std::ostream& out) const;
+		// throws std::runtime_error on invalid input
+		static pvar_summary read(std::istream& in);
+	};
+	pvar_summary pvar_summarize(const NumericVector& x, double p);
+	pvar_summary pvar_summarize(const double* x, size_t n, double p);
+	// summary of left followed by right, both for the same p, otherwise throws std::invalid_argument
+	pvar_summary pvar_merge(const pvar_summary& left, const pvar_summary& right);
+
+	// p-variation of many sub-intervals of one sequence:
+	//   pvar_index index(x);
+	//   double pv = index.query(a, b, p);
+	// equals pvar(x.data() + a, b - a + 1, p), for 0 <= a <= b < size(x).
+	// For each p a segment tree of summaries (see pvar_summary) of blocks of x is built on first use,
+	// and a query merges the summaries of the O(log n) blocks which make up [a, b].
+	// x is not copied and must outlive the index. Queries change the index,
+	// so one index must not be used by several threads at once.
+	class pvar_index {
+	public:
+		explicit pvar_index(const NumericVector& x);
+		pvar_index(const double* x, size_t n);
+		
+		double query(size_t a, size_t b, double p);
+		size_t size() const {
+			return n;
+		}
+		
+	private:
+		// levels[l][i] is the summary of x[i * (block << l)], ..., x[(i + 1) * (block << l) - 1]
+		typedef std::vector<std::vector<pvar_summary> > tree_t;
+		const tree_t& tree(double p);
+		
+		static const size_t block = 256;
+		const double* x;
+		size_t n;
+		std::map<double, tree_t> trees;
+	};
+
+	// -------------------------------- definitions of types  ---------------------------------- //
+	// index_t is the type of indices into x: uint32_t keeps the data compact,
+	// uint64_t is used when size(x) >= UINT32_MAX.
+	// The types in detail are internal to pvar, they are declared here only to make basic_workspace complete.
+	namespace detail {
+		template <typename index_t>
+		struct basic_pointdata {
+			index_t prev, next; // emulate double-linked list
+			double pvdiff; // Difference to previous
+		};
+	
+		template <typename index_t>
+		using basic_DoublyLinkedList = std::vector<basic_pointdata<index_t> >;    // list of admissible points, in form of forward and backward links
+	
+		template <typename index_t>
+		struct basic_pvtemppoint{
+			index_t it;
+			double ev;
+		};
+	
+		// temporary data used by Merge2GoodInt. Declaring it once avoids allocating/deallocating it at each call of Merge2GoodInt.
+		template <typename index_t>
+		struct basic_MergeBuffers {
+			std::vector<basic_pvtemppoint<index_t> > av_mins, av_maxs, vb_mins, vb_maxs;
+		};
+	} // namespace detail
+	
+	template <typename index_t>
+	struct basic_workspace {
+		detail::basic_DoublyLinkedList<index_t> links;
+		detail::basic_MergeBuffers<index_t> merge;
+		std::vector<index_t> IterList; // end points of optimal intervals
+	};
+	
+	// all memory used by pvar, kept between calls;
+	// ws64 is used only for x with at least UINT32_MAX points
+	struct workspace {
+		basic_workspace<uint32_t> ws32;
+		basic_workspace<uint64_t> ws64;
+	};
+
+	// p-variation of the last window points of a sequence which grows by one point at a time.
+	// The optimal partition of the window is kept between calls and updated with each push:
+	// * the new point is merged in at the back with Merge2GoodInt;
+	// * when the first point leaves, the rest of the partition from its second point on stays optimal,
+	//   so only the front up to that point is partitioned again, from the turning points in between,
+	//   and merged with the rest.
+	// A tick costs O(partition size + turning points before the second partition point) instead of
+	// O(window); the second term is large only when the partition has few points, e.g. on a trend.
+	class pvar_window {
+	public:
+		pvar_window(size_t window, double p);
+
+		void push(double x);
+		double value() const;
+		size_t size() const { return points.size(); }
+
+	private:
+		size_t window;
+		double p;
+		size_t count = 0;
+		int direction = 0;
+		std::deque<double> points; // last window points
+		std::deque<std::pair<size_t, double> > turning; // turning points strictly inside the window
+		std::vector<std::pair<size_t, double> > partition; // optimal partition of the window: index and value
+		std::vector<std::pair<size_t, double> > front; // buffer for the front of the window
+		std::vector<size_t> positions;
+		NumericVector values;
+		workspace ws;
+
+		void drop_front();
+	};
 }
@@ -11,8 +11,16 @@
 #include <vector>
 #include <array>
 #include <ctime>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
 
 #include "p_var.h"
+#include "p_var_batch.h"
+#include "mmap_path.h"
+#include "p_var_out_of_core.h"
+#include "p_var_file.h"
 #include "p_var_real.h"
 
 using p_var_ns::p_var;
@@ -130,6 +138,27 @@ void test_dist_template()
 		dist(0, 3);
 }
 
+// resident memory in bytes: current for "VmRSS:", peak since reset_peak_resident() for "VmHWM:",
+// Linux only, 0 elsewhere
+void reset_peak_resident() {
+#ifdef __linux__
+	std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+size_t resident(const std::string & key) {
+#ifdef __linux__
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, key.size(), key) == 0) {
+			return size_t(std::stoull(line.substr(key.size()))) * 1024;
+		}
+	}
+#endif
+	return 0;
+}
+
 // test the sequence returned by p_var:
 // compute p-variation over that sequence and return abs difference
 template<typename p_var_ret_t, typename power_t, typename path_t,
@@ -339,6 +368,1195 @@ int main() {
 		cout << "  max error: " << max_err << "\n";
 	}
 
+	// real line method with 32 and 64 bit indices
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		size_t count = 100;
+		size_t steps = 10000;
+		double max_err = 0.0;
+		p_var_real::basic_workspace<uint32_t> ws32;
+		p_var_real::basic_workspace<uint64_t> ws64;
+
+		for (double p : {1.0, 2.5, 3.0}) {
+			for (size_t c = 0; c < count; c++) {
+				double sd = 1 / sqrt(double(steps));
+				std::vector<double> path = make_brownian_path(sd, steps);
+				double pv = p_var_real::pvar(path, p);
+				double pv32 = p_var_real::pvar(path, p, ws32);
+				double pv64 = p_var_real::pvar(path, p, ws64);
+				max_err = std::max(max_err, std::abs(pv32 - pv) + std::abs(pv64 - pv));
+			}
+		}
+		cout << count << " random Brownian paths of length " << steps
+			<< " for each of p=1, 2.5, 3, real line method with 32 and 64 bit indices\n";
+		cout << "  max error: " << max_err << "\n";
+	}
+
+	// paths in memory mapped files
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+		size_t steps = 100000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<double> path = make_brownian_path(sd, steps);
+		std::vector<double> path_y = make_brownian_path(sd, steps);
+		std::vector<vecRd> path2(steps + 1);
+		for (size_t j = 0; j < path2.size(); j++) {
+			path2[j] = {{path[j], path_y[j]}};
+		}
+		const char * file_name = "test_mmap_path.bin";
+		const char * file_name2 = "test_mmap_path2.bin";
+		std::ofstream(file_name, std::ios::binary).write(reinterpret_cast<const char *>(path.data()), path.size() * sizeof(double));
+		std::ofstream(file_name2, std::ios::binary).write(reinterpret_cast<const char *>(path2.data()), path2.size() * sizeof(vecRd));
+
+		double pv_err;
+		{
+			p_var_ns::mmap_path<double> mpath(file_name);
+			p_var_ns::mmap_path<vecRd> mpath2(file_name2);
+			pv_err = std::abs(p_var_real::pvar(mpath.data(), mpath.size(), p) - p_var_real::pvar(path, p))
+				+ std::abs(p_var(mpath.begin(), mpath.end(), p).value - p_var(path, p).value)
+				+ std::abs(p_var(mpath2.begin(), mpath2.end(), p, distRd).value - p_var(path2, p, distRd).value)
+				+ std::abs(double(mpath.size()) - double(path.size())) + std::abs(double(mpath2.size()) - double(path2.size()));
+		}
+		std::remove(file_name);
+		std::remove(file_name2);
+
+		cout << "Brownian paths in R^1 and R^" << d << " of length " << steps
+			<< " read from memory mapped files\n";
+		cout << "  error: " << pv_err << "\n";
+	}
+
+	// path files with the cached extrema and spatial index
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		size_t steps = 300000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<double> path = make_brownian_path(sd, steps);
+		std::vector<double> path_y = make_brownian_path(sd, steps);
+		std::vector<vecRd> path2(steps + 1);
+		for (size_t j = 0; j < path2.size(); j++) {
+			path2[j] = {{path[j], path_y[j]}};
+		}
+		const char * file_name = "test_path_file.pvp";
+		const char * file_name2 = "test_path_file2.pvp";
+		p_var_ns::write_path_file(file_name, p_var_real::pvar_extrema(path), p_var_ns::path_file_kind::extrema);
+		p_var_ns::write_path_file(file_name2, path2, p_var_ns::path_file_kind::path, distRd);
+
+		double pv_err = 0;
+		double seconds = 0, file_seconds = 0, real_seconds = 0, real_file_seconds = 0;
+		{
+			p_var_ns::path_file<double> file(file_name);
+			p_var_ns::path_file<vecRd> file2(file_name2);
+			pv_err += (file.kind() == p_var_ns::path_file_kind::extrema ? 0 : 1) + (file.has_index() ? 1 : 0)
+				+ (file2.has_index() && file2.size() == path2.size() ? 0 : 1);
+			for (double p : {1.5, 2., 2.5, 3.5}) {
+				clock_t clock_begin = std::clock();
+				double pv_real = p_var_real::pvar(path, p);
+				clock_t clock_file = std::clock();
+				double pv_real_file = p_var_real::pvar_reduced(file.data(), file.size(), p);
+				clock_t clock_end = std::clock();
+				real_seconds += double(clock_file - clock_begin) / CLOCKS_PER_SEC;
+				real_file_seconds += double(clock_end - clock_file) / CLOCKS_PER_SEC;
+
+				clock_begin = std::clock();
+				auto pv = p_var(path2, p, distRd);
+				clock_file = std::clock();
+				auto pv_file = p_var(file2, p, distRd);
+				clock_end = std::clock();
+				seconds += double(clock_file - clock_begin) / CLOCKS_PER_SEC;
+				file_seconds += double(clock_end - clock_file) / CLOCKS_PER_SEC;
+
+				pv_err += std::abs(pv_real_file - pv_real) + std::abs(pv_file.value - pv.value)
+					+ (pv_file.points == pv.points ? 0 : 1);
+			}
+		}
+
+		// files of another point type, version or length are rejected
+		size_t rejected = 0;
+		try {
+			p_var_ns::path_file<vecRd> file(file_name);
+		} catch (const std::runtime_error &) {
+			rejected++;
+		}
+		try {
+			p_var_ns::path_file<float> file(file_name);
+		} catch (const std::runtime_error &) {
+			rejected++;
+		}
+		std::ofstream(file_name, std::ios::binary | std::ios::in | std::ios::out).seekp(4).put(2);
+		try {
+			p_var_ns::path_file<double> file(file_name);
+		} catch (const std::runtime_error &) {
+			rejected++;
+		}
+		p_var_ns::write_path_file(file_name, path.data(), path.data() + 10);
+		std::ofstream(file_name, std::ios::binary | std::ios::in | std::ios::out).seekp(0).put('x');
+		try {
+			p_var_ns::path_file<double> file(file_name);
+		} catch (const std::runtime_error &) {
+			rejected++;
+		}
+		// a length which overflows the size in bytes
+		p_var_ns::write_path_file(file_name, path.data(), path.data() + 10);
+		uint64_t wrapping_length = (uint64_t(1) << 61) + 1;
+		std::ofstream(file_name, std::ios::binary | std::ios::in | std::ios::out).seekp(24)
+			.write(reinterpret_cast<const char *>(&wrapping_length), sizeof(wrapping_length));
+		try {
+			p_var_ns::path_file<double> file(file_name);
+		} catch (const std::runtime_error &) {
+			rejected++;
+		}
+		pv_err += double(5 - rejected);
+
+		// without dist, the index of the default distance is used
+		std::vector<double> short_path(path.begin(), path.begin() + 1000);
+		p_var_ns::write_path_file(file_name, short_path, p_var_ns::path_file_kind::path, distR1);
+		{
+			p_var_ns::path_file<double> file(file_name);
+			auto pv = p_var(short_path, 2.5);
+			auto pv_file = p_var(file, 2.5);
+			pv_err += (file.has_index() ? 0 : 1) + std::abs(pv_file.value - pv.value) + (pv_file.points == pv.points ? 0 : 1);
+		}
+		std::remove(file_name);
+		std::remove(file_name2);
+
+		cout << "Brownian paths in R^1 and R^" << d << " of length " << steps
+			<< " in path files with the extrema and the spatial index, for 4 values of p\n";
+		cout << "  real line method seconds: " << real_seconds << ", from the extrema: " << real_file_seconds << "\n";
+		cout << "  p_var seconds: " << seconds << ", from the index: " << file_seconds << "\n";
+		cout << "  error: " << pv_err << "\n";
+	}
+
+	// out of core computation with bounded memory
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+
+		// short paths in tiny chunks
+		double chunk_err = 0;
+		for (size_t steps = 0; steps < 200; steps += 7) {
+			std::vector<double> path = make_brownian_path(1., steps);
+			for (size_t chunk_size = 3; chunk_size < 12; chunk_size++) {
+				size_t pos = 0;
+				double pv_chunked = p_var_real::pvar_chunked([&](double * buffer, size_t k) {
+					size_t count = std::min(k, path.size() - pos);
+					std::copy(path.begin() + pos, path.begin() + pos + count, buffer);
+					pos += count;
+					return count;
+				}, p, chunk_size);
+				chunk_err = std::max(chunk_err, std::abs(pv_chunked - p_var_real::pvar(path, p)));
+			}
+		}
+
+		size_t steps = 2000000;
+		double sd = 1 / sqrt(double(steps));
+		const char * file_name = "test_out_of_core.bin";
+		double pv_real;
+		p_var_ns::p_var_ret_t<double> pv;
+		{
+			std::vector<double> path = make_brownian_path(sd, steps);
+			std::ofstream(file_name, std::ios::binary).write(reinterpret_cast<const char *>(path.data()), path.size() * sizeof(double));
+			pv_real = p_var_real::pvar(path, p);
+			pv = p_var(path, p);
+		}
+
+		size_t max_memory = size_t(1) << 20;
+		size_t baseline = resident("VmRSS:");
+		reset_peak_resident();
+		clock_t clock_begin = std::clock();
+		double pv_file = p_var_real::pvar_file(file_name, p, max_memory);
+		clock_t clock_end = std::clock();
+		size_t real_peak = resident("VmHWM:") - baseline;
+
+		p_var_ns::p_var_out_of_core_options options;
+		options.scratch_dir = ".";
+		options.max_resident = size_t(16) << 20;
+		p_var_ns::p_var_ret_t<double> pv_ooc;
+		reset_peak_resident();
+		clock_t ooc_clock_begin = std::clock();
+		{
+			p_var_ns::mmap_path<double> mpath(file_name);
+			pv_ooc = p_var_out_of_core(mpath, p, distR1, options);
+		}
+		clock_t ooc_clock_end = std::clock();
+		size_t ooc_peak = resident("VmHWM:") - baseline;
+		std::remove(file_name);
+
+		double pv_err = chunk_err + std::abs(pv_file - pv_real) + std::abs(pv_ooc.value - pv.value)
+			+ (pv_ooc.points == pv.points ? 0 : 1);
+		cout << "Brownian path of length " << steps << " in a file, " << steps * 32 / (1 << 20)
+			<< " MiB of data and working memory of p_var\n";
+		cout << "  real line method in chunks of " << (max_memory >> 20) << " MiB, seconds: "
+			<< double(clock_end - clock_begin) / CLOCKS_PER_SEC << ", peak MiB above baseline: " << (real_peak >> 20) << "\n";
+		cout << "  out of core p_var with at most " << (options.max_resident >> 20) << " MiB resident, seconds: "
+			<< double(ooc_clock_end - ooc_clock_begin) / CLOCKS_PER_SEC << ", peak MiB above baseline: " << (ooc_peak >> 20) << "\n";
+		cout << "  error: " << pv_err << "\n";
+	}
+
+	// many short paths with and without workspaces
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 3;
+		size_t count = 20000;
+		size_t steps = 100;
+		std::vector<std::vector<double> > paths;
+		for (size_t c = 0; c < count; c++) {
+			paths.push_back(make_brownian_path(1 / sqrt(double(steps)), steps));
+		}
+
+		double max_err = 0.0;
+		p_var_ns::p_var_workspace<double> ws;
+		p_var_real::workspace ws_real;
+		// both timed loops do the same work, the checks come after them
+		std::vector<double> pvs_ws(count), pvs_real_ws(count), pvs(count), pvs_real(count);
+		clock_t clock_begin = std::clock();
+		for (size_t c = 0; c < count; c++) {
+			pvs_ws[c] = p_var(paths[c], p, distR1, ws).value;
+			pvs_real_ws[c] = p_var_real::pvar(paths[c], p, ws_real);
+		}
+		clock_t clock_end = std::clock();
+
+		clock_t ref_clock_begin = std::clock();
+		for (size_t c = 0; c < count; c++) {
+			pvs[c] = p_var(paths[c], p, distR1).value;
+			pvs_real[c] = p_var_real::pvar(paths[c], p);
+		}
+		clock_t ref_clock_end = std::clock();
+
+		for (size_t c = 0; c < count; c++) {
+			auto & pv = p_var(paths[c], p, distR1, ws);
+			max_err = std::max(max_err, std::abs(pvs_ws[c] - pvs_real_ws[c]) + std::abs(pvs[c] - pvs_real[c])
+				+ std::abs(pvs_ws[c] - pvs[c]) + p_var_points_check(pv, p, paths[c], distR1));
+		}
+
+		cout << count << " random Brownian paths of length " << steps << "\n";
+		cout << "  seconds with workspaces: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+			<< ", without: " << double(ref_clock_end - ref_clock_begin) / CLOCKS_PER_SEC << "\n";
+
+		// very short paths, where the allocations are a large part of the time
+		size_t short_count = 500000;
+		size_t short_steps = 4;
+		std::vector<std::vector<double> > short_paths;
+		for (size_t c = 0; c < short_count; c++) {
+			short_paths.push_back(make_brownian_path(1 / sqrt(double(short_steps)), short_steps));
+		}
+		double pv_sum = 0, pv_ws_sum = 0, pv_real_sum = 0, pv_real_ws_sum = 0;
+		clock_t clock_0 = std::clock();
+		for (const auto & path : short_paths) {
+			pv_ws_sum += p_var(path, p, distR1, ws).value;
+		}
+		clock_t clock_1 = std::clock();
+		for (const auto & path : short_paths) {
+			pv_sum += p_var(path, p, distR1).value;
+		}
+		clock_t clock_2 = std::clock();
+		for (const auto & path : short_paths) {
+			pv_real_ws_sum += p_var_real::pvar(path, p, ws_real);
+		}
+		clock_t clock_3 = std::clock();
+		for (const auto & path : short_paths) {
+			pv_real_sum += p_var_real::pvar(path, p);
+		}
+		clock_t clock_4 = std::clock();
+		max_err = std::max(max_err, (std::abs(pv_ws_sum - pv_sum) + std::abs(pv_real_ws_sum - pv_real_sum)
+			+ std::abs(pv_real_sum - pv_sum)) / pv_sum);
+
+		cout << short_count << " random Brownian paths of length " << short_steps << "\n";
+		cout << "  generic seconds with workspace: " << double(clock_1 - clock_0) / CLOCKS_PER_SEC
+			<< ", without: " << double(clock_2 - clock_1) / CLOCKS_PER_SEC << "\n";
+		cout << "  real line method seconds with workspace: " << double(clock_3 - clock_2) / CLOCKS_PER_SEC
+			<< ", without: " << double(clock_4 - clock_3) / CLOCKS_PER_SEC << "\n";
+		cout << "  max error: " << max_err << "\n";
+	}
+
+	// many exponents at once, compared to separate computations
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		size_t steps = 100000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<double> path = make_brownian_path(sd, steps);
+		std::vector<double> ps;
+		for (double p = 1.0; p < 8.01; p += 0.25) {
+			ps.push_back(p);
+		}
+
+		clock_t clock_begin = std::clock();
+		auto pvs = p_var_ns::p_var_multi(path, ps);
+		std::vector<double> pvs_real = p_var_real::pvar_multi(path, ps);
+		clock_t clock_end = std::clock();
+
+		double max_err = 0.0;
+		clock_t ref_clock_begin = std::clock();
+		for (size_t k = 0; k < ps.size(); k++) {
+			auto pv = p_var(path, ps[k]);
+			double pv_real = p_var_real::pvar(path, ps[k]);
+			double pv_err = std::abs(pvs[k].value - pv.value) + std::abs(pvs_real[k] - pv_real)
+				+ std::abs(pvs[k].value - pv_real) / pv_real;
+			double pv_points_err = p_var_points_check(pvs[k], ps[k], path);
+			max_err = std::max(max_err, pv_err + pv_points_err);
+		}
+		clock_t ref_clock_end = std::clock();
+
+		cout << "Brownian path of length " << steps << ", " << ps.size()
+			<< " exponents from " << ps.front() << " to " << ps.back() << "\n";
+		cout << "  seconds for all exponents at once: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+			<< ", separately: " << double(ref_clock_end - ref_clock_begin) / CLOCKS_PER_SEC << "\n";
+		cout << "  max error: " << max_err << "\n";
+	}
+
+	// streaming p-variation compared to p-variation of prefixes
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+		size_t steps = 100000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<double> path_x = make_brownian_path(sd, steps);
+		std::vector<double> path_y = make_brownian_path(sd, steps);
+		std::vector<vecRd> path(steps + 1);
+		for (size_t j = 0; j < path.size(); j++) {
+			path[j] = {{path_x[j], path_y[j]}};
+		}
+
+		double max_err = 0.0;
+		clock_t clock_begin = std::clock();
+		p_var_ns::p_var_stream<vecRd, decltype(&distRd)> pvs(p, distRd);
+		for (size_t j = 0; j < path.size(); j++) {
+			pvs.push(path[j]);
+			if (j % 9973 == 0 || j + 1 == path.size()) {
+				auto pv = p_var(path.begin(), path.begin() + j + 1, p, distRd);
+				p_var_ns::p_var_ret_t<double> pvs_ret{pvs.value(), pvs.points()};
+				max_err = std::max(max_err, std::abs(pvs.value() - pv.value)
+					+ p_var_points_check(pvs_ret, p, path, distRd));
+			}
+		}
+		clock_t clock_end = std::clock();
+
+		cout << "Brownian path in R^" << d << " with L^1 distance of length " << steps
+			<< " pushed point by point, compared to p-variation of prefixes\n";
+		cout << "  seconds: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+			<< ", max error: " << max_err << "\n";
+	}
+
+	// column of a row-major matrix and separate coordinate arrays, compared to copies
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+		size_t steps = 10000;
+		size_t cols = 3;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<std::vector<double> > columns(cols);
+		std::vector<double> matrix((steps + 1) * cols);
+		for (size_t c = 0; c < cols; c++) {
+			columns[c] = make_brownian_path(sd, steps);
+			for (size_t j = 0; j <= steps; j++) {
+				matrix[j * cols + c] = columns[c][j];
+			}
+		}
+		std::vector<vecRd> path(steps + 1);
+		for (size_t j = 0; j < path.size(); j++) {
+			path[j] = {{columns[0][j], columns[1][j]}};
+		}
+
+		double max_err = 0.0;
+		for (size_t c = 0; c < cols; c++) {
+			p_var_ns::strided_view<double> column(matrix.data() + c, steps + 1, cols);
+			auto pv = p_var(column, p);
+			auto pv_ref = p_var(columns[c], p);
+			max_err = std::max(max_err, std::abs(pv.value - pv_ref.value) + p_var_points_check(pv, p, columns[c]));
+		}
+		p_var_ns::soa_view<double, d> soa({{columns[0].data(), columns[1].data()}}, steps + 1);
+		auto pv = p_var(soa, p, distRd);
+		auto pv_ref = p_var(path, p, distRd);
+		max_err = std::max(max_err, std::abs(pv.value - pv_ref.value) + p_var_points_check(pv, p, path, distRd));
+
+		cout << "Brownian paths of length " << steps << " as columns of a matrix and as separate coordinates\n";
+		cout << "  max error: " << max_err << "\n";
+	}
+
+	// distance kernels for std::array compared to the generic distance on std::vector
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		const size_t D = 16;
+		double p = 2.5;
+		size_t steps = 100000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<std::array<double, D> > path(steps + 1);
+		std::vector<std::vector<double> > path_vec(steps + 1, std::vector<double>(D));
+		std::vector<std::array<float, D> > path_float(steps + 1);
+		for (size_t i = 0; i < D; i++) {
+			std::vector<double> x = make_brownian_path(sd, steps);
+			for (size_t j = 0; j <= steps; j++) {
+				path[j][i] = path_vec[j][i] = x[j];
+				path_float[j][i] = float(x[j]);
+			}
+		}
+		auto dist_vec = [](const std::vector<double> & a, const std::vector<double> & b) {
+			return p_var_ns::internal::dist(a, b);
+		};
+		auto l1_vec = [](const std::vector<double> & a, const std::vector<double> & b) {
+			double s = 0;
+			for (size_t i = 0; i < a.size(); i++) {
+				s += std::abs(b[i] - a[i]);
+			}
+			return s;
+		};
+
+		clock_t clock_begin = std::clock();
+		auto pv = p_var(path, p, p_var_ns::euclidean_dist());
+		auto pv_l1 = p_var(path, p, p_var_ns::l1_dist());
+		clock_t clock_end = std::clock();
+		auto pv_ref = p_var(path_vec, p, dist_vec);
+		auto pv_l1_ref = p_var(path_vec, p, l1_vec);
+		clock_t ref_clock_end = std::clock();
+		auto pv_float = p_var(path_float, p, p_var_ns::euclidean_dist());
+		// the default distance sums in the same order for std::array and std::vector
+		auto pv_default = p_var(path, p);
+
+		double max_err = std::abs(pv.value - pv_ref.value) / pv_ref.value
+			+ std::abs(pv_l1.value - pv_l1_ref.value) / pv_l1_ref.value
+			+ std::abs(pv_default.value - pv_ref.value)
+			+ p_var_points_check(pv, p, path, p_var_ns::euclidean_dist())
+			+ p_var_points_check(pv_l1, p, path, p_var_ns::l1_dist());
+		double float_err = std::abs(pv_float.value - pv_ref.value) / pv_ref.value;
+
+		cout << "Brownian path in R^" << D << " of length " << steps << ", Euclidean and L^1 distances\n";
+		cout << "  seconds for std::array: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+			<< ", std::vector: " << double(ref_clock_end - clock_end) / CLOCKS_PER_SEC
+			<< ", max error: " << max_err
+			<< ", relative difference with float: " << float_err << "\n";
+	}
+
+	// pre-filter of repeated and collinear points
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+		size_t steps = 200000;
+		// lattice walk in Z^2 which moves in runs along one direction, with pauses
+		unsigned int seed;
+		std::default_random_engine generator(random_seed(seed));
+		std::uniform_int_distribution<int> move(0, 4);
+		std::uniform_int_distribution<int> run(1, 8);
+		std::vector<vecRd> path(1, {{0, 0}});
+		std::vector<double> path_x(1, 0);
+		while (path.size() <= steps) {
+			int m = move(generator);
+			int r = run(generator);
+			double dx = (m == 1) - (m == 2);
+			double dy = (m == 3) - (m == 4);
+			for (int k = 0; k < r; k++) {
+				path.push_back({{path.back()[0] + dx, path.back()[1] + dy}});
+				path_x.push_back(path.back()[0]);
+			}
+		}
+		p_var_ns::p_var_prefilter filter;
+		filter.collinear = true;
+		p_var_ns::p_var_prefilter duplicates_only;
+
+		clock_t clock_begin = std::clock();
+		auto pv = p_var(path, p);
+		clock_t clock_end = std::clock();
+		auto pv_filtered = p_var(path, p, p_var_ns::internal::dist<vecRd>, filter);
+		clock_t filtered_clock_end = std::clock();
+		auto pv_duplicates = p_var(path, p, p_var_ns::internal::dist<vecRd>, duplicates_only);
+		auto pv_x = p_var(path_x, p, distR1, filter);
+		size_t kept = p_var_ns::p_var_prefilter_points(path.begin(), path.end(), p_var_ns::internal::dist<vecRd>, filter).size();
+
+		double pv_err = (std::abs(pv_filtered.value - pv.value) + std::abs(pv_duplicates.value - pv.value)) / pv.value
+			+ std::abs(pv_x.value - p_var_real::pvar(path_x, p)) / pv_x.value
+			+ p_var_points_check(pv_filtered, p, path) + p_var_points_check(pv_duplicates, p, path)
+			+ p_var_points_check(pv_x, p, path_x);
+		cout << "Lattice walk in R^2 of length " << path.size() - 1 << " with runs and pauses, "
+			<< kept << " points kept by the pre-filter\n";
+		cout << "  seconds: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+			<< ", with pre-filter: " << double(filtered_clock_end - clock_end) / CLOCKS_PER_SEC
+			<< ", error: " << pv_err << "\n";
+	}
+
+	// spatial index in float, distances and p-variation in double
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+		size_t steps = 1000000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<double> path = make_brownian_path(sd, steps);
+
+		p_var_ns::p_var_workspace<double> ws;
+		p_var_ns::p_var_workspace<double, double, float> ws_float;
+		clock_t clock_begin = std::clock();
+		auto & pv = p_var(path, p, distR1, ws);
+		clock_t clock_end = std::clock();
+		auto & pv_float = p_var(path, p, distR1, ws_float);
+		clock_t float_clock_end = std::clock();
+
+		double pv_err = std::abs(pv_float.value - pv.value) + (pv_float.points == pv.points ? 0 : 1)
+			+ p_var_points_check(pv_float, p, path);
+		cout << "Brownian path of length " << steps << ", spatial index in double and in float\n";
+		cout << "  seconds: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+			<< ", with float index: " << double(float_clock_end - clock_end) / CLOCKS_PER_SEC
+			<< ", error: " << pv_err << "\n";
+	}
+
+	// blocked layout of the spatial index gives the same bounds as the flat one
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double max_err = 0;
+		for (size_t steps = 1; steps <= 5000; steps = steps * 3 + 1) {
+			std::vector<double> path = make_brownian_path(1., steps);
+			auto path_dist = [&path](size_t a, size_t b) {
+				return std::abs(path[b] - path[a]);
+			};
+			p_var_ns::internal::dyadic_index<double> flat(path.size());
+			p_var_ns::internal::blocked_dyadic_index<double> blocked(path.size());
+			for (size_t j = 0; j < path.size(); j++) {
+				flat.add(j, path_dist);
+				blocked.add(j, path_dist);
+			}
+			for (size_t j = 0; j < path.size(); j++) {
+				for (size_t n = 1; n <= flat.N; n++) {
+					if (flat.covers(j, n)) {
+						max_err = std::max(max_err, std::abs(flat.bound(j, n) - blocked.bound(j, n)));
+					}
+				}
+			}
+		}
+		cout << "Flat and blocked spatial index layouts for Brownian paths of lengths up to 5000\n";
+		cout << "  max error: " << max_err << "\n";
+	}
+
+	// distance cache, counting evaluations of the distance
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+		size_t steps = 100000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<double> path_x = make_brownian_path(sd, steps);
+		std::vector<double> path_y = make_brownian_path(sd, steps);
+		std::vector<vecRd> path(steps + 1);
+		for (size_t j = 0; j < path.size(); j++) {
+			path[j] = {{path_x[j], path_y[j]}};
+		}
+		size_t evaluations = 0;
+		auto counted_dist = [&evaluations](const vecRd & a, const vecRd & b) {
+			evaluations++;
+			return distRd(a, b);
+		};
+
+		auto pv = p_var(path, p, counted_dist);
+		size_t uncached_evaluations = evaluations;
+		evaluations = 0;
+		p_var_ns::p_var_dist_cache<double> cache(size_t(1) << 20);
+		auto pv_cached = p_var(path, p, counted_dist, cache);
+
+		double pv_err = std::abs(pv_cached.value - pv.value) + p_var_points_check(pv_cached, p, path, distRd)
+			+ (pv_cached.points == pv.points ? 0 : 1) + (cache.misses() == evaluations ? 0 : 1);
+		cout << "Brownian path in R^" << d << " of length " << steps << " with a distance cache of "
+			<< (size_t(1) << 20) << " entries\n";
+		cout << "  distance evaluations without cache: " << uncached_evaluations
+			<< ", with cache: " << evaluations
+			<< ", hit rate: " << double(cache.hits()) / double(cache.hits() + cache.misses())
+			<< ", error: " << pv_err << "\n";
+
+		// a metric on the indices of the points, recording the pairs it measures:
+		// with a large enough cache, no pair is measured twice
+		size_t n = 10000;
+		std::vector<size_t> ids(n);
+		std::iota(ids.begin(), ids.end(), size_t(0));
+		std::vector<std::pair<size_t, size_t> > pairs;
+		auto pair_dist = [&path, &pairs](size_t a, size_t b) {
+			pairs.emplace_back(std::min(a, b), std::max(a, b));
+			return distRd(path[a], path[b]);
+		};
+		p_var_ns::p_var_dist_cache<double> small_cache(size_t(1) << 12);
+		auto pv_ids = p_var(ids, p, pair_dist, small_cache);
+		std::sort(pairs.begin(), pairs.end());
+		size_t repeated = pairs.end() - std::unique(pairs.begin(), pairs.end());
+		std::vector<vecRd> prefix(path.begin(), path.begin() + n);
+		double ids_err = std::abs(pv_ids.value - p_var(prefix, p, distRd).value) + double(repeated);
+		cout << "  path of " << n << " points with a cache of " << (size_t(1) << 12)
+			<< " entries, pairs measured twice: " << repeated << ", error: " << ids_err << "\n";
+	}
+
+	// upward trend with oscillations: long lists of candidates in Merge2GoodInt
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		size_t steps = 20000;
+		unsigned int seed;
+		std::default_random_engine generator(random_seed(seed));
+		std::uniform_real_distribution<double> amplitude(0.5, 1.5);
+		std::vector<double> path(steps + 1);
+		for (size_t k = 0; k <= steps; k++) {
+			path[k] = 0.01 * double(k) + (k % 2 ? 1 : -1) * amplitude(generator);
+		}
+		for (double p : {1.5, 2.5}) {
+			clock_t clock_begin = std::clock();
+			double pv = p_var_real::pvar(path, p);
+			clock_t clock_end = std::clock();
+			auto pv_ref = p_var(path, p, distR1);
+			double pv_err = std::abs(pv - pv_ref.value) / pv_ref.value + p_var_points_check(pv_ref, p, path);
+			cout << "Trend with oscillations of length " << steps << ", p=" << p << ": " << pv << "\n";
+			cout << "  seconds: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+				<< ", error: " << pv_err << "\n";
+		}
+	}
+
+	// p-variation of disjoint chunks merged from serialized summaries
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+		size_t steps = 100000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<double> path = make_brownian_path(sd, steps);
+		unsigned int seed;
+		std::default_random_engine generator(random_seed(seed));
+		std::uniform_int_distribution<size_t> chunk_length(1, 5000);
+
+		std::vector<p_var_real::pvar_summary> summaries;
+		for (size_t begin = 0; begin < path.size(); ) {
+			size_t end = std::min(path.size(), begin + chunk_length(generator));
+			std::stringstream stream;
+			p_var_real::pvar_summarize(path.data() + begin, end - begin, p).write(stream);
+			summaries.push_back(p_var_real::pvar_summary::read(stream));
+			begin = end;
+		}
+		p_var_real::pvar_summary left_to_right;
+		for (const auto & summary : summaries) {
+			left_to_right = p_var_real::pvar_merge(left_to_right, summary);
+		}
+		std::vector<p_var_real::pvar_summary> tree(summaries);
+		while (tree.size() > 1) {
+			std::vector<p_var_real::pvar_summary> next;
+			for (size_t k = 0; k + 1 < tree.size(); k += 2) {
+				next.push_back(p_var_real::pvar_merge(tree[k], tree[k + 1]));
+			}
+			if (tree.size() % 2 == 1) {
+				next.push_back(tree.back());
+			}
+			tree.swap(next);
+		}
+
+		double pv = p_var_real::pvar(path, p);
+		double pv_err = (std::abs(left_to_right.value() - pv) + std::abs(tree[0].value() - pv)) / pv
+			+ (left_to_right.points == tree[0].points ? 0 : 1);
+		cout << "Brownian path of length " << steps << " in " << summaries.size()
+			<< " chunks, merged left to right and pairwise\n";
+		cout << "  points: " << left_to_right.points.size() << ", error: " << pv_err << "\n";
+	}
+
+	// p-variation of all prefixes in one pass
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		size_t steps = 1000000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<std::pair<const char *, std::vector<double> > > paths = {
+			{"Brownian", make_brownian_path(sd, steps)},
+			{"intermittent", make_intermittent_path(steps, 0.6)}};
+		for (const auto & named_path : paths) {
+			const auto & path = named_path.second;
+			for (double p : {1.5, 2.5}) {
+				clock_t clock_begin = std::clock();
+				std::vector<double> prefix = p_var_ns::p_var_prefix(path, p, distR1);
+				clock_t clock_end = std::clock();
+				std::vector<double> prefix_real = p_var_real::pvar_prefix(path, p);
+				clock_t real_clock_end = std::clock();
+				std::vector<double> prefix_out(path.size());
+				p_var_ns::p_var_prefix(path.begin(), path.end(), p, distR1, prefix_out.data());
+
+				double pv_err = 0;
+				for (size_t j = 0; j < path.size(); j++) {
+					pv_err = std::max(pv_err, (std::abs(prefix_real[j] - prefix[j]) + std::abs(prefix_out[j] - prefix[j]))
+						/ std::max(1., prefix[j]));
+				}
+				for (size_t j : {size_t(0), size_t(1), size_t(2), size_t(10), steps / 3, steps}) {
+					pv_err = std::max(pv_err, std::abs(prefix[j] - p_var_real::pvar(path.data(), j + 1, p)) / std::max(1., prefix[j]));
+				}
+				cout << named_path.first << " path of length " << steps << ", p=" << p
+					<< ", p-variation of all prefixes\n";
+				cout << "  seconds: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+					<< ", real line specific method: " << double(real_clock_end - clock_end) / CLOCKS_PER_SEC
+					<< ", error: " << pv_err << "\n";
+			}
+		}
+	}
+
+	// comparison with a threshold, stopping early
+	{
+		cout << "\n*** TEST " << ++test_no << " ***\n";
+		double p = 2.5;
+		size_t steps = 1000000;
+		std::vector<double> path = make_brownian_path(1 / sqrt(double(steps)), steps);
+		clock_t clock_begin = std::clock();
+		double pv = p_var_ns::p_var_value(path, p, distR1);
+		clock_t clock_end = std::clock();
+		double pv_real = p_var_real::pvar(path, p);
+		clock_t real_clock_end = std::clock();
+		cout << "Brownian path of length " << steps << ", p=" << p << ", p-variation " << pv
+			<< " computed in " << double(clock_end - clock_begin) / CLOCKS_PER_SEC << " and "
+			<< double(real_clock_end - clock_end) / CLOCKS_PER_SEC << " seconds\n";
+		for (double fraction : {0.01, 0.5, 0.999, 1.001, 1e6}) {
+			double threshold = fraction * pv;
+			clock_t clock_begin = std::clock();
+			bool exceeds = p_var_ns::p_var_exceeds(path, p, threshold, distR1);
+			clock_t clock_end = std::clock();
+			bool exceeds_real = p_var_real::pvar_exceeds(path, p, threshold);
+			clock_t real_clock_end = std::clock();
+			int pv_err = (exceeds != (pv > threshold)) + (exceeds_real != (pv_real > threshold));
+			cout << "  threshold " << threshold << ": " << (exceeds ? "exceeded" : "not exceeded")
+				<< ", seconds: " << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+				<< ", real line specific method: " << double(real_clock_end - clock_end) / CLOCKS_PER_SEC
+				<< ", error: " << pv_err << "\n";
+		}
+
+		// lengths around the chunks of pvar_exceeds, p close to 1 for long partitions
+		int chunk_err = 0;
+		for (size_t n : {size_t(65536), size_t(65537), size_t(65538), size_t(200000)}) {
+			std::vector<double> x = make_brownian_path(1 / sqrt(double(n)), n - 1);
+			for (double q : {1.1, 2.5}) {
+				double pv_x = p_var_real::pvar(x, q);
+				for (double fraction : {0.999, 1.001}) {
+					chunk_err += p_var_real::pvar_exceeds(x, q, fraction * pv_x) != (fraction < 1);
+				}
+			}
+		}
+		cout << "  paths of 2^16 to 200000 points, p=1.1 and 2.5, error: " << chunk_err << "\n";
+
+		// a long path whose optimal partition for p close to 1 keeps every point
+		size_t n = 4000000;
+		double q = 1.1;
+		std::vector<double> zigzag(n);
+		for (size_t i = 0; i < n; i++) {
+			zigzag[i] = (i % 2 ? -1.0 : 1.0) * sqrt(double(i));
+		}
+		clock_t zigzag_clock_begin = std::clock();
+		double pv_zigzag = p_var_real::pvar(zigzag, q);
+		clock_t zigzag_clock_end = std::clock();
+		int zigzag_err = !p_var_real::pvar_exceeds(zigzag, q, 0.999 * pv_zigzag);
+		zigzag_err += p_var_real::pvar_exceeds(zigzag, q, 1.001 * pv_zigzag);
+		clock_t exceeds_clock_end = std::clock();
+		cout << "  zigzag of " << n << " points, p=" << q << ", seconds for pvar: "
+			<< double(zigzag_clock_end - zigzag_clock_begin) / CLOCKS_PER_SEC
+			<< ", for pvar_exceeds at 0.999 and 1.001 times the p-variation: "
+			<< double(exceeds_clock_end - zigzag_clock_end) / CLOCKS_PER_SEC
+			<< ", error: " << zigzag_err << "\n";
+	}
+
+	// sliding window benchmark
+	{
+		cout << "\n*** TEST " << ++test_no << ": SLIDING WINDOW BENCHMARK ***\n";
+		double p = 3;
+		size_t window = 10000;
+		size_t ticks = 200;
+		double sd = 1 / sqrt(double(window));
+		std::vector<double> path = make_brownian_path(sd, window + ticks);
+
+		p_var_ns::p_var_window<double, decltype(&distR1)> pvw(window, p, distR1);
+		p_var_real::pvar_window pvw_real(window, p);
+		for (size_t j = 0; j + 1 < window; j++) {
+			pvw.push(path[j]);
+			pvw_real.push(path[j]);
+		}
+
+		double max_err = 0.0;
+		clock_t win_secs = 0, real_win_secs = 0, naive_secs = 0, real_naive_secs = 0;
+		for (size_t t = window; t <= path.size(); t++) {
+			clock_t clock_0 = std::clock();
+			pvw.push(path[t-1]);
+			double pv_win = pvw.value();
+			clock_t clock_1 = std::clock();
+			pvw_real.push(path[t-1]);
+			double pv_real_win = pvw_real.value();
+			clock_t clock_2 = std::clock();
+			auto pv = p_var(path.begin() + (t - window), path.begin() + t, p, distR1);
+			clock_t clock_3 = std::clock();
+			std::vector<double> last(path.begin() + (t - window), path.begin() + t);
+			double pv_real = p_var_real::pvar(last, p);
+			clock_t clock_4 = std::clock();
+
+			win_secs += clock_1 - clock_0;
+			real_win_secs += clock_2 - clock_1;
+			naive_secs += clock_3 - clock_2;
+			real_naive_secs += clock_4 - clock_3;
+
+			p_var_ns::p_var_ret_t<double> pvw_ret{pv_win, pvw.points()};
+			double pv_points_err = p_var_points_check(pvw_ret, p, last, distR1);
+			max_err = std::max(max_err, std::abs(pv_win - pv.value) + std::abs(pv_real_win - pv_real)
+				+ std::abs(pv_real - pv.value) + pv_points_err);
+		}
+
+		auto per_tick = [ticks](clock_t c) { return double(c) / CLOCKS_PER_SEC / (ticks + 1); };
+		cout << "p-variation with p=" << p << " over a window of " << window
+			<< " points of a Brownian path, for " << ticks + 1 << " consecutive ticks\n"
+			<< std::setw(15) << "Method"
+			<< std::setw(15) << "Window secs"
+			<< std::setw(15) << "Rerun secs"
+			<< "\n"
+			<< std::setw(15) << "generic"
+			<< std::setw(15) << per_tick(win_secs)
+			<< std::setw(15) << per_tick(naive_secs)
+			<< "\n"
+			<< std::setw(15) << "real line"
+			<< std::setw(15) << per_tick(real_win_secs)
+			<< std::setw(15) << per_tick(real_naive_secs)
+			<< "\n";
+
+		// short windows of walks with plateaus and trends, for several p
+		std::default_random_engine generator(1);
+		std::uniform_int_distribution<int> step(-1, 2);
+		for (size_t w = 1; w <= 40; w += 3) {
+			for (double q : {1., 1.5, 2.5, 4.}) {
+				p_var_real::pvar_window pvw_short(w, q);
+				std::vector<double> walk;
+				double x = 0;
+				for (size_t t = 0; t < 300; t++) {
+					x += step(generator) * (w % 2 ? 1. : 0.5);
+					walk.push_back(x);
+					pvw_short.push(x);
+					std::vector<double> last(walk.end() - std::min(w, walk.size()), walk.end());
+					double pv_short = p_var_real::pvar(last, q);
+					max_err = std::max(max_err, std::abs(pvw_short.value() - pv_short) / std::max(1., pv_short));
+				}
+			}
+		}
+		cout << "  max error, also for windows of 1 to 40 points of walks with plateaus: " << max_err << "\n";
+	}
+
+	// parallel real line method
+	{
+		cout << "\n*** TEST " << ++test_no << ": PARALLEL BENCHMARK ***\n";
+		double p = 3;
+		unsigned threads = 4;
+		cout << "Real line method with " << threads << " threads compared to serial one, wall clock seconds\n"
+			<< std::setw(15) << "Length"
+			<< std::setw(15) << "p-variation"
+			<< std::setw(15) << "Par secs"
+			<< std::setw(15) << "R mthd secs"
+			<< std::setw(15) << "Error"
+			<< "\n";
+		for (size_t steps = 100000; steps <= 10000000; steps *= 10) {
+			double sd = 1 / sqrt(double(steps));
+			std::vector<double> path = make_brownian_path(sd, steps);
+
+			auto clock_begin = std::chrono::steady_clock::now();
+			double pv = p_var_real::pvar_parallel(path, p, threads);
+			auto clock_end = std::chrono::steady_clock::now();
+
+			auto ref_clock_begin = std::chrono::steady_clock::now();
+			double pv_ref = p_var_real::pvar(path, p);
+			auto ref_clock_end = std::chrono::steady_clock::now();
+
+			cout	<< std::setw(15) << steps
+				<< std::setw(15) << pv
+				<< std::setw(15) << std::chrono::duration<double>(clock_end - clock_begin).count()
+				<< std::setw(15) << std::chrono::duration<double>(ref_clock_end - ref_clock_begin).count()
+				<< std::setw(15) << std::abs(pv - pv_ref)
+				<< "\n";
+		}
+	}
+
+	// many paths at once
+	{
+		cout << "\n*** TEST " << ++test_no << ": BATCH BENCHMARK ***\n";
+		double p = 3;
+		std::vector<std::vector<double> > paths;
+		for (size_t c = 0; c < 1000; c++) {
+			size_t steps = (c % 100 == 0) ? 100000 : 100 + 10 * c;
+			paths.push_back(make_brownian_path(1 / sqrt(double(steps)), steps));
+		}
+
+		p_var_ns::p_var_batch_options options;
+		options.threads = 4;
+		auto clock_begin = std::chrono::steady_clock::now();
+		auto pvs = p_var_ns::p_var_batch(paths, p, distR1, options);
+		auto clock_end = std::chrono::steady_clock::now();
+
+		double max_err = 0.0;
+		auto ref_clock_begin = std::chrono::steady_clock::now();
+		for (size_t c = 0; c < paths.size(); c++) {
+			auto pv = p_var(paths[c], p, distR1);
+			max_err = std::max(max_err, std::abs(pvs[c].value - pv.value) + p_var_points_check(pvs[c], p, paths[c], distR1));
+		}
+		auto ref_clock_end = std::chrono::steady_clock::now();
+
+		cout << paths.size() << " Brownian paths of lengths from 100 to 100000, "
+			<< options.threads << " threads, wall clock seconds\n";
+		cout << "  batch: " << std::chrono::duration<double>(clock_end - clock_begin).count()
+			<< ", one by one: " << std::chrono::duration<double>(ref_clock_end - ref_clock_begin).count()
+			<< ", max error: " << max_err << "\n";
+
+		// the same paths packed into one vector for the real line specific method
+		std::vector<double> values;
+		std::vector<size_t> offsets(1, 0);
+		for (const auto & path : paths) {
+			values.insert(values.end(), path.begin(), path.end());
+			offsets.push_back(values.size());
+		}
+		auto real_clock_begin = std::chrono::steady_clock::now();
+		std::vector<double> pvs_real = p_var_real::pvar_batch(values, offsets, p, options.threads);
+		auto real_clock_end = std::chrono::steady_clock::now();
+		double real_err = 0.0;
+		for (size_t c = 0; c < paths.size(); c++) {
+			real_err = std::max(real_err, std::abs(pvs_real[c] - pvs[c].value));
+		}
+		cout << "  real line specific method, packed batch: "
+			<< std::chrono::duration<double>(real_clock_end - real_clock_begin).count()
+			<< ", max error: " << real_err << "\n";
+	}
+
+	// range queries
+	{
+		cout << "\n*** TEST " << ++test_no << ": RANGE QUERY BENCHMARK ***\n";
+		double p = 2.5;
+		size_t steps = 1000000;
+		size_t queries = 300;
+		size_t max_length = 10000;
+		std::vector<double> path = make_brownian_path(1 / sqrt(double(steps)), steps);
+		unsigned int seed;
+		std::default_random_engine generator(random_seed(seed));
+		std::uniform_int_distribution<size_t> start(0, steps);
+		std::uniform_int_distribution<size_t> length(0, max_length);
+		std::vector<std::pair<size_t, size_t> > ranges;
+		for (size_t k = 0; k < queries; k++) {
+			size_t a = start(generator);
+			ranges.emplace_back(a, std::min(steps, a + length(generator)));
+		}
+
+		clock_t clock_begin = std::clock();
+		p_var_real::pvar_index real_index(path);
+		real_index.query(0, steps, p);
+		clock_t clock_end = std::clock();
+		cout << "Brownian path of length " << steps << ", p=" << p << ", " << queries
+			<< " queries [a, b] with b - a up to " << max_length << ",\n"
+			<< "index built in " << double(clock_end - clock_begin) / CLOCKS_PER_SEC << " seconds\n"
+			<< std::setw(15) << "Method"
+			<< std::setw(15) << "Queries/sec"
+			<< std::setw(15) << "Error"
+			<< "\n";
+
+		std::vector<double> pv_ref;
+		for (const auto & range : ranges) {
+			pv_ref.push_back(p_var_real::pvar(path.data() + range.first, range.second - range.first + 1, p));
+		}
+		auto row = [&](const char * method, auto query) {
+			double pv_err = 0;
+			clock_t clock_begin = std::clock();
+			for (size_t k = 0; k < queries; k++) {
+				double pv = query(ranges[k].first, ranges[k].second);
+				pv_err = std::max(pv_err, std::abs(pv - pv_ref[k]) / std::max(1., pv_ref[k]));
+			}
+			clock_t clock_end = std::clock();
+			cout	<< std::setw(15) << method
+				<< std::setw(15) << queries / (double(clock_end - clock_begin) / CLOCKS_PER_SEC)
+				<< std::setw(15) << pv_err
+				<< "\n";
+		};
+		row("p_var", [&](size_t a, size_t b) {
+			return p_var(path.begin() + a, path.begin() + b + 1, p, distR1).value;
+		});
+		row("pvar", [&](size_t a, size_t b) {
+			return p_var_real::pvar(path.data() + a, b - a + 1, p);
+		});
+		row("pvar_index", [&](size_t a, size_t b) {
+			return real_index.query(a, b, p);
+		});
+	}
+
+	// exponents known at compile time
+	{
+		cout << "\n*** TEST " << ++test_no << ": POWER BENCHMARK ***\n";
+		size_t steps = 1000000;
+		double sd = 1 / sqrt(double(steps));
+		std::vector<double> path = make_brownian_path(sd, steps);
+		cout << "Brownian path of length " << steps << ", p given as double and as power<num, den>,\n"
+			<< "real line specific method for p and for the next double after p (using std::pow)\n"
+			<< std::setw(15) << "p"
+			<< std::setw(15) << "Seconds"
+			<< std::setw(15) << "power secs"
+			<< std::setw(15) << "R mthd secs"
+			<< std::setw(15) << "R pow secs"
+			<< std::setw(15) << "Error"
+			<< "\n";
+		auto row = [&path](auto power) {
+			double p = power;
+
+			clock_t clock_begin = std::clock();
+			auto pv = p_var(path, p);
+			clock_t clock_end = std::clock();
+
+			clock_t power_clock_begin = std::clock();
+			auto pv_power = p_var(path, power);
+			clock_t power_clock_end = std::clock();
+
+			clock_t ref_clock_begin = std::clock();
+			double pv_real = p_var_real::pvar(path, p);
+			clock_t ref_clock_end = std::clock();
+
+			clock_t pow_clock_begin = std::clock();
+			double pv_real_pow = p_var_real::pvar(path, std::nextafter(p, 5.));
+			clock_t pow_clock_end = std::clock();
+
+			double pv_err = (std::abs(pv_power.value - pv.value) + std::abs(pv_real - pv.value)
+				+ std::abs(pv_real_pow - pv.value)) / pv.value
+				+ p_var_points_check(pv_power, p, path);
+
+			cout	<< std::setw(15) << p
+				<< std::setw(15) << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+				<< std::setw(15) << double(power_clock_end - power_clock_begin) / CLOCKS_PER_SEC
+				<< std::setw(15) << double(ref_clock_end - ref_clock_begin) / CLOCKS_PER_SEC
+				<< std::setw(15) << double(pow_clock_end - pow_clock_begin) / CLOCKS_PER_SEC
+				<< std::setw(15) << pv_err
+				<< "\n";
+		};
+		row(p_var_ns::power<2>());
+		row(p_var_ns::power<5, 2>());
+		row(p_var_ns::power<3>());
+		row(p_var_ns::power<4>());
+	}
+
+	// fixed dimension front-end
+	{
+		cout << "\n*** TEST " << ++test_no << ": FIXED DIMENSION BENCHMARK ***\n";
+		double p = 2.5;
+		size_t steps = 1000000;
+		double sd = 1 / sqrt(double(steps));
+		cout << "Brownian paths in R^D of length " << steps << ", p=" << p
+			<< ", generic p_var and p_var<D>, Euclidean distance\n"
+			<< std::setw(15) << "D"
+			<< std::setw(15) << "p-variation"
+			<< std::setw(15) << "Seconds"
+			<< std::setw(15) << "p_var<D> secs"
+			<< std::setw(15) << "Error"
+			<< "\n";
+		auto row = [&](auto dim) {
+			const size_t D = decltype(dim)::value;
+			std::vector<std::array<double, D> > path(steps + 1);
+			for (size_t i = 0; i < D; i++) {
+				std::vector<double> x = make_brownian_path(sd, steps);
+				for (size_t j = 0; j <= steps; j++) {
+					path[j][i] = x[j];
+				}
+			}
+
+			clock_t clock_begin = std::clock();
+			auto pv = p_var(path, p, p_var_ns::euclidean_dist());
+			clock_t clock_end = std::clock();
+			auto pv_fixed = p_var<D>(path, p);
+			clock_t fixed_clock_end = std::clock();
+
+			double pv_err = std::abs(pv_fixed.value - pv.value) / pv.value + (pv_fixed.points == pv.points ? 0 : 1);
+			cout	<< std::setw(15) << D
+				<< std::setw(15) << pv.value
+				<< std::setw(15) << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+				<< std::setw(15) << double(fixed_clock_end - clock_end) / CLOCKS_PER_SEC
+				<< std::setw(15) << pv_err
+				<< "\n";
+		};
+		row(std::integral_constant<size_t, 2>());
+		row(std::integral_constant<size_t, 3>());
+		row(std::integral_constant<size_t, 4>());
+	}
+
+	// distance kernels compared to the default distance
+	{
+		cout << "\n*** TEST " << ++test_no << ": DISTANCE KERNEL BENCHMARK ***\n";
+		double p = 2.5;
+		cout << "Brownian paths in R^D of D * length 1000000, p=" << p
+			<< ", default distance, euclidean_dist and l1_dist\n"
+			<< std::setw(15) << "D"
+			<< std::setw(15) << "default secs"
+			<< std::setw(15) << "euclidean secs"
+			<< std::setw(15) << "l1 secs"
+			<< std::setw(15) << "Error"
+			<< "\n";
+		auto row = [&](auto dim) {
+			const size_t D = decltype(dim)::value;
+			size_t steps = 1000000 / D;
+			double sd = 1 / sqrt(double(steps));
+			std::vector<std::array<double, D> > path(steps + 1);
+			for (size_t i = 0; i < D; i++) {
+				std::vector<double> x = make_brownian_path(sd, steps);
+				for (size_t j = 0; j <= steps; j++) {
+					path[j][i] = x[j];
+				}
+			}
+
+			clock_t clock_begin = std::clock();
+			auto pv_default = p_var(path, p);
+			clock_t default_clock_end = std::clock();
+			auto pv = p_var(path, p, p_var_ns::euclidean_dist());
+			clock_t clock_end = std::clock();
+			auto pv_l1 = p_var(path, p, p_var_ns::l1_dist());
+			clock_t l1_clock_end = std::clock();
+
+			double pv_err = std::abs(pv.value - pv_default.value) / pv_default.value
+				+ p_var_points_check(pv, p, path, p_var_ns::euclidean_dist())
+				+ p_var_points_check(pv_l1, p, path, p_var_ns::l1_dist());
+			cout	<< std::setw(15) << D
+				<< std::setw(15) << double(default_clock_end - clock_begin) / CLOCKS_PER_SEC
+				<< std::setw(15) << double(clock_end - default_clock_end) / CLOCKS_PER_SEC
+				<< std::setw(15) << double(l1_clock_end - clock_end) / CLOCKS_PER_SEC
+				<< std::setw(15) << pv_err
+				<< "\n";
+		};
+		row(std::integral_constant<size_t, 4>());
+		row(std::integral_constant<size_t, 16>());
+		row(std::integral_constant<size_t, 64>());
+	}
+
+	// approximation with bounds
+	{
+		cout << "\n*** TEST " << ++test_no << ": APPROXIMATION BENCHMARK ***\n";
+		size_t steps = 1000000;
+		double sd = 1 / sqrt(double(steps));
+		cout << "Brownian paths in R^" << d << " of length " << steps
+			<< ", bounds of p_var_approx with a relative tolerance or a time budget,\n"
+			<< "compared to the exact p_var: (exact - lower) / exact and (upper - exact) / exact\n"
+			<< std::setw(10) << "p"
+			<< std::setw(15) << "Exact secs"
+			<< std::setw(15) << "Method"
+			<< std::setw(15) << "Seconds"
+			<< std::setw(15) << "Lower gap"
+			<< std::setw(15) << "Upper gap"
+			<< std::setw(15) << "Error"
+			<< "\n";
+		std::vector<double> path_x = make_brownian_path(sd, steps);
+		std::vector<double> path_y = make_brownian_path(sd, steps);
+		std::vector<vecRd> path(steps + 1);
+		for (size_t j = 0; j < path.size(); j++) {
+			path[j] = {{path_x[j], path_y[j]}};
+		}
+		for (double p : {2.5, 3.5}) {
+			clock_t clock_begin = std::clock();
+			auto pv = p_var(path, p, distRd);
+			clock_t clock_end = std::clock();
+			double exact_secs = double(clock_end - clock_begin) / CLOCKS_PER_SEC;
+
+			auto row = [&](const char * method, double tolerance, double seconds) {
+				p_var_ns::p_var_approx_options options;
+				options.tolerance = tolerance;
+				options.seconds = seconds;
+				clock_t clock_begin = std::clock();
+				auto pv_approx = p_var_approx(path, p, distRd, options);
+				clock_t clock_end = std::clock();
+				// the bounds must contain the exact value, and pv_approx.points must reach the lower bound
+				p_var_ns::p_var_ret_t<double> pv_lower{pv_approx.lower, pv_approx.points};
+				double pv_err = std::max(0., pv_approx.lower - pv.value) / pv.value
+					+ std::max(0., pv.value - pv_approx.upper) / pv.value
+					+ p_var_points_check(pv_lower, p, path, distRd) / pv.value;
+				cout	<< std::setw(10) << p
+					<< std::setw(15) << exact_secs
+					<< std::setw(15) << method
+					<< std::setw(15) << double(clock_end - clock_begin) / CLOCKS_PER_SEC
+					<< std::setw(15) << (pv.value - pv_approx.lower) / pv.value
+					<< std::setw(15) << (pv_approx.upper - pv.value) / pv.value
+					<< std::setw(15) << pv_err
+					<< "\n";
+			};
+			row("tol 10%", 0.1, 0);
+			row("tol 1%", 0.01, 0);
+			row("5% of time", 0, 0.05 * exact_secs);
+			row("20% of time", 0, 0.2 * exact_secs);
+		}
+	}
+
 	// benchmark
 	{
 		cout << "\n*** TEST " << ++test_no << ": BROWNIAN BENCHMARK ***\n";
@@ -349,6 +1567,7 @@ int main() {
 			<< std::setw(15) << "p-variation"
 			<< std::setw(15) << "Seq length"
 			<< std::setw(15) << "Seconds"
+			<< std::setw(15) << "Value secs"
 			<< std::setw(15) << "R mthd secs"
 			<< std::setw(15) << "Error"
 			<< "\n";
@@ -360,20 +1579,26 @@ int main() {
 			auto pv = p_var(path, p);
 			clock_t clock_end = std::clock();
 
+			clock_t value_clock_begin = std::clock();
+			double pv_value = p_var_ns::p_var_value(path, p);
+			clock_t value_clock_end = std::clock();
+
 			clock_t ref_clock_begin = std::clock();
 			double pv_ref = p_var_real::pvar(path, p);
 			clock_t ref_clock_end = std::clock();
 
 			double elapsed_secs = double(clock_end - clock_begin) / CLOCKS_PER_SEC;
+			double value_elapsed_secs = double(value_clock_end - value_clock_begin) / CLOCKS_PER_SEC;
 			double ref_elapsed_secs = double(ref_clock_end - ref_clock_begin) / CLOCKS_PER_SEC;
 
-			double pv_err = std::abs(pv.value - pv_ref);
+			double pv_err = std::abs(pv.value - pv_ref) + std::abs(pv_value - pv_ref);
 			double pv_points_err = p_var_points_check(pv, p, path);
 
 			cout	<< std::setw(15) << steps
 				<< std::setw(15) << pv.value
 				<< std::setw(15) << pv.points.size()
 				<< std::setw(15) << elapsed_secs
+				<< std::setw(15) << value_elapsed_secs
 				<< std::setw(15) << ref_elapsed_secs
 				<< std::setw(15) << pv_err + pv_points_err
 				<< "\n";
@@ -393,6 +1618,7 @@ int main() {
 			<< std::setw(15) << "p-variation"
 			<< std::setw(15) << "Seq length"
 			<< std::setw(15) << "Seconds"
+			<< std::setw(15) << "Value secs"
 			<< std::setw(15) << "R mthd secs"
 			<< std::setw(15) << "Error"
 			<< "\n";
@@ -403,25 +1629,68 @@ int main() {
 			auto pv = p_var(path, p);
 			clock_t clock_end = std::clock();
 
+			clock_t value_clock_begin = std::clock();
+			double pv_value = p_var_ns::p_var_value(path, p);
+			clock_t value_clock_end = std::clock();
+
 			clock_t ref_clock_begin = std::clock();
 			double pv_ref = p_var_real::pvar(path, p);
 			clock_t ref_clock_end = std::clock();
 
 			double elapsed_secs = double(clock_end - clock_begin) / CLOCKS_PER_SEC;
+			double value_elapsed_secs = double(value_clock_end - value_clock_begin) / CLOCKS_PER_SEC;
 			double ref_elapsed_secs = double(ref_clock_end - ref_clock_begin) / CLOCKS_PER_SEC;
 
-			double pv_err = std::abs(pv.value - pv_ref);
+			double pv_err = std::abs(pv.value - pv_ref) + std::abs(pv_value - pv_ref);
 			double pv_points_err = p_var_points_check(pv, p, path);
 
 			cout	<< std::setw(15) << steps
 				<< std::setw(15) << pv.value
 				<< std::setw(15) << pv.points.size()
 				<< std::setw(15) << elapsed_secs
+				<< std::setw(15) << value_elapsed_secs
 				<< std::setw(15) << ref_elapsed_secs
 				<< std::setw(15) << pv_err + pv_points_err
 				<< "\n";
 		}
 	}
 
+#ifdef P_VAR_STATS
+	// statistics, compiled with -DP_VAR_STATS (make stats)
+	{
+		cout << "\n*** TEST " << ++test_no << ": STATISTICS ***\n";
+		size_t steps = 1000000;
+		double alpha = 0.6;
+		double p = 1. / alpha + 0.25;
+		std::vector<std::pair<const char *, std::vector<double> > > paths = {
+			{"Brownian", make_brownian_path(1 / sqrt(double(steps)), steps)},
+			{"intermittent", make_intermittent_path(steps, alpha)}};
+		cout << "Paths of length " << steps << ", p=" << p << "\n";
+		for (const auto & named_path : paths) {
+			const auto & path = named_path.second;
+			p_var_ns::p_var_stats().reset();
+			p_var_real::pvar_stats().reset();
+			auto pv = p_var(path, p);
+			double pv_ref = p_var_real::pvar(path, p);
+			const auto & stats = p_var_ns::p_var_stats();
+			const auto & real_stats = p_var_real::pvar_stats();
+
+			cout << "  " << named_path.first << ": error " << std::abs(pv.value - pv_ref) << "\n"
+				<< "    generic: dist calls " << stats.dist_calls
+				<< ", m iterations per point " << double(stats.m_iterations) / stats.steps
+				<< ", max " << stats.max_m_iterations << "\n"
+				<< "    skips per level:";
+			for (size_t n = 0; n < stats.skips.size(); n++) {
+				if (stats.skips[n] > 0) {
+					cout << " " << n << ":" << stats.skips[n];
+				}
+			}
+			cout << "\n    real line: extrema " << real_stats.extrema
+				<< ", removed by short intervals " << real_stats.short_removed
+				<< ", merge candidates " << real_stats.merge_candidates << "\n";
+		}
+	}
+#endif
+
 	return 0;
 }